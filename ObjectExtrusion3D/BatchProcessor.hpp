@@ -0,0 +1,467 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BATCH_PROCESSOR_HPP
+#define BATCH_PROCESSOR_HPP
+
+#include "Scene.hpp"
+#include "Storyboard.hpp"
+#include "ThreadPool.hpp"
+#include "MeshBuilder.hpp"
+#include "StlExporter.hpp"
+#include "MeshExporter.hpp"
+#include "List.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <unordered_set>
+#include <mutex>
+#include <chrono>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <Windows.h>
+#else
+    #include <dirent.h>
+#endif
+
+enum MeshFormat {
+    FORMAT_STL,
+    FORMAT_OBJ,
+    FORMAT_PLY,
+    FORMAT_UNKNOWN
+};
+
+// Finds the mesh format from the extension of a file name.
+inline MeshFormat FormatFromPath(const char *path) {
+    const char *extension = strrchr(path, '.');
+    if(extension == NULL) return FORMAT_UNKNOWN;
+
+    char lower[8];
+    size_t length = strlen(extension + 1);
+    if(length >= sizeof(lower)) return FORMAT_UNKNOWN;
+
+    for(size_t i = 0; i <= length; i++) {
+        char c = extension[i + 1];
+        lower[i] = ((c >= 'A') && (c <= 'Z')) ? (c - 'A' + 'a') : c;
+    }
+
+    if(strcmp(lower, "stl") == 0) return FORMAT_STL;
+    if(strcmp(lower, "obj") == 0) return FORMAT_OBJ;
+    if(strcmp(lower, "ply") == 0) return FORMAT_PLY;
+    return FORMAT_UNKNOWN;
+}
+
+inline const char *FormatExtension(MeshFormat format) {
+    switch(format) {
+        case FORMAT_STL: return ".stl";
+        case FORMAT_OBJ: return ".obj";
+        case FORMAT_PLY: return ".ply";
+        default:         return "";
+    }
+}
+
+// The result of extruding one scene. The times are in milliseconds.
+struct BatchResult {
+    std::string Input;
+    std::string Output;
+    const char *Error; // NULL if the scene was written.
+    size_t Frames;
+    size_t Triangles;
+    double LoadTime;
+    double ExtrudeTime;
+    double WriteTime;
+
+    BatchResult() : Error(NULL), Frames(0), Triangles(0), 
+                    LoadTime(0), ExtrudeTime(0), WriteTime(0) {}
+};
+
+// Extrudes many scenes, one per pool task. The scenes themselves are played
+// without the pool, which gives better throughput than splitting each one.
+// A scene is loaded only when a thread starts working on it, so at most one
+// scene per thread is in memory. The scene, frames and mesh buffers are kept
+// by a set of worker contexts and reused from one file to the next.
+// In float mode the frames and the mesh are computed in float32.
+class BatchProcessor {
+private:
+    // The objects reused between scenes.
+    struct WorkerContext {
+        Scene scene;
+        MeshBuilder builder;
+        FrameStoreF framesF;
+        MeshBuilderF builderF;
+    };
+
+    class SceneTask : public IRangeTask {
+    private:
+        BatchProcessor *processor_;
+
+    public:
+        SceneTask(BatchProcessor *processor) : processor_(processor) {}
+
+        virtual void Run(size_t begin, size_t end) {
+            WorkerContext *context = processor_->AcquireContext();
+
+            for(size_t i = begin; i < end; i++) {
+                processor_->Process(*processor_->results_[i], *context);
+            }
+
+            processor_->ReleaseContext(context);
+        }
+    };
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    MeshFormat format_;
+    bool useFloat_;
+    double tolerance_; // Negative to use the one saved with the scene.
+    List<BatchResult *> results_;
+    std::unordered_set<std::string> outputs_; // Normalized, see NormalizePath.
+    List<WorkerContext *> contexts_;
+    List<WorkerContext *> freeContexts_;
+    std::mutex contextLock_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    BatchProcessor(MeshFormat format, bool useFloat = false) : 
+            format_(format), useFloat_(useFloat), tolerance_(-1) {
+        assert(format != FORMAT_UNKNOWN);
+    }
+
+    ~BatchProcessor() {
+        for(size_t i = 0; i < results_.Count(); i++) {
+            delete results_[i];
+        }
+
+        for(size_t i = 0; i < contexts_.Count(); i++) {
+            delete contexts_[i];
+        }
+    }
+
+    //
+    // Public methods.
+    //
+    // A scene whose output is the same as the one of a scene added before
+    // (like a/glass.scn and b/glass.scn written in the same directory)
+    // is not extruded and is reported as failed.
+    void Add(const std::string &input, const std::string &output) {
+        BatchResult *result = new BatchResult();
+        result->Input = input;
+        result->Output = output;
+
+        if(!outputs_.insert(NormalizePath(output)).second) {
+            result->Error = "duplicate output";
+        }
+
+        results_.Add(result);
+    }
+
+    // Adds a scene whose output is written in the given directory,
+    // with the name of the scene and the extension of the format.
+    void AddToDirectory(const std::string &input, const std::string &outputDirectory) {
+        size_t nameStart = input.find_last_of("/\\");
+        nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+        std::string name = input.substr(nameStart);
+        size_t extension = name.find_last_of('.');
+
+        if(extension != std::string::npos) {
+            name = name.substr(0, extension);
+        }
+
+        Add(input, JoinPath(outputDirectory, name + FormatExtension(format_)));
+    }
+
+    // Adds the scenes found at 'path', which is either a directory
+    // (all .scn files in it) or a manifest with one scene path per line.
+    // Returns false if 'path' can't be read.
+    bool AddScenes(const std::string &path, const std::string &outputDirectory) {
+        if(IsDirectory(path)) {
+            return AddDirectory(path, outputDirectory);
+        }
+        
+        return AddManifest(path, outputDirectory);
+    }
+
+    // Tessellates the Bezier scenes with the given tolerance
+    // instead of the one saved with them.
+    void SetTolerance(double value) {
+        assert(value >= 0);
+        // --------------------------------
+        tolerance_ = value;
+    }
+
+    size_t Count() const {
+        return results_.Count();
+    }
+
+    const BatchResult &Result(size_t index) const {
+        return *results_[index];
+    }
+
+    size_t FailedCount() const {
+        size_t count = 0;
+
+        for(size_t i = 0; i < results_.Count(); i++) {
+            if(results_[i]->Error != NULL) count++;
+        }
+
+        return count;
+    }
+
+    // Extrudes all scenes. Without a pool they are extruded on the calling thread.
+    void Run(ThreadPool *pool = NULL) {
+        SceneTask task(this);
+
+        if(pool == NULL) {
+            task.Run(0, results_.Count());
+        }
+        else pool->ParallelFor(task, results_.Count(), 1);
+    }
+
+private:
+    BatchProcessor(const BatchProcessor &other);
+    BatchProcessor &operator =(const BatchProcessor &other);
+
+    WorkerContext *AcquireContext() {
+        std::lock_guard<std::mutex> guard(contextLock_);
+
+        if(freeContexts_.Count() > 0) {
+            WorkerContext *context = freeContexts_[freeContexts_.Count() - 1];
+            freeContexts_.Truncate(freeContexts_.Count() - 1);
+            return context;
+        }
+
+        WorkerContext *context = new WorkerContext();
+        contexts_.Add(context);
+        return context;
+    }
+
+    void ReleaseContext(WorkerContext *context) {
+        std::lock_guard<std::mutex> guard(contextLock_);
+        freeContexts_.Add(context);
+    }
+
+    void Process(BatchResult &result, WorkerContext &context) {
+        if(result.Error != NULL) {
+            return; // Rejected when it was added.
+        }
+
+        wchar_t input[4096];
+        wchar_t output[4096];
+
+        if(!WidePath(result.Input, input, 4096) || !WidePath(result.Output, output, 4096)) {
+            result.Error = "invalid path";
+            return;
+        }
+
+        Clock::time_point start = Clock::now();
+        Scene &scene = context.scene;
+
+        if(!scene.Open(input) || (scene.ShapeObject() == NULL)) {
+            result.Error = "cannot read scene";
+            return;
+        }
+
+        if(tolerance_ >= 0) {
+            scene.SetTolerance(tolerance_);
+        }
+
+        Storyboard &storyboard = scene.Storyboard();
+        result.Frames = storyboard.FrameCount();
+        result.LoadTime = ElapsedMs(start);
+        bool saved;
+
+        if(format_ == FORMAT_STL) {
+            // The STL exporter evaluates the frames while writing them.
+            start = Clock::now();
+            StlExporter exporter;
+            saved = exporter.Save(storyboard, output);
+            result.Triangles = exporter.TriangleCount();
+            result.WriteTime = ElapsedMs(start);
+        }
+        else if(useFloat_) {
+            // Frames restored from the cache are used as they are.
+            start = Clock::now();
+            context.builderF.Clear();
+
+            if(storyboard.IsGenerated()) {
+                context.builderF.Update(storyboard.Frames());
+            }
+            else {
+                storyboard.GenerateFrames(context.framesF);
+                context.builderF.Update(context.framesF);
+            }
+
+            saved = WriteMesh(result, start, context.builderF.MeshObject(), output);
+        }
+        else {
+            start = Clock::now();
+            if(!storyboard.IsGenerated()) {
+                storyboard.GenerateFrames();
+            }
+
+            context.builder.Clear();
+            context.builder.Update(storyboard.Frames());
+            saved = WriteMesh(result, start, context.builder.MeshObject(), output);
+        }
+
+        if(!saved) {
+            result.Error = "cannot write mesh";
+        }
+    }
+
+    // Writes the mesh which was built since 'start' in the OBJ or PLY format.
+    template <class P>
+    bool WriteMesh(BatchResult &result, Clock::time_point start, 
+                   BasicMesh<P> &mesh, wchar_t *output) {
+        result.Triangles = mesh.TriangleCount();
+        result.ExtrudeTime = ElapsedMs(start);
+
+        start = Clock::now();
+        bool saved;
+
+        if(format_ == FORMAT_OBJ) {
+            ObjExporter exporter;
+            saved = exporter.Save(mesh, output);
+        }
+        else {
+            PlyExporter exporter;
+            saved = exporter.Save(mesh, output);
+        }
+
+        result.WriteTime = ElapsedMs(start);
+        return saved;
+    }
+
+    bool AddDirectory(const std::string &directory, const std::string &outputDirectory) {
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA(JoinPath(directory, "*.scn").c_str(), &data);
+        if(find == INVALID_HANDLE_VALUE) return true; // No scenes.
+
+        do {
+            if((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+                AddToDirectory(JoinPath(directory, data.cFileName), outputDirectory);
+            }
+        } while(FindNextFileA(find, &data));
+
+        FindClose(find);
+        return true;
+#else
+        DIR *dir = opendir(directory.c_str());
+        if(dir == NULL) return false;
+
+        while(dirent *entry = readdir(dir)) {
+            size_t length = strlen(entry->d_name);
+
+            if((length > 4) && (strcmp(entry->d_name + length - 4, ".scn") == 0)) {
+                std::string path = JoinPath(directory, entry->d_name);
+                if(!IsDirectory(path)) AddToDirectory(path, outputDirectory);
+            }
+        }
+
+        closedir(dir);
+        return true;
+#endif
+    }
+
+    bool AddManifest(const std::string &manifest, const std::string &outputDirectory) {
+        FILE *file = fopen(manifest.c_str(), "r");
+        if(file == NULL) return false;
+
+        // Empty lines and lines starting with # are ignored.
+        char line[4096];
+
+        while(fgets(line, sizeof(line), file) != NULL) {
+            size_t length = strlen(line);
+
+            while((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r') ||
+                                   (line[length - 1] == ' ')  || (line[length - 1] == '\t'))) {
+                line[--length] = 0;
+            }
+
+            if((length > 0) && (line[0] != '#')) {
+                AddToDirectory(line, outputDirectory);
+            }
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    static bool IsDirectory(const std::string &path) {
+        struct stat info;
+        return (stat(path.c_str(), &info) == 0) && ((info.st_mode & S_IFMT) == S_IFDIR);
+    }
+
+    static std::string JoinPath(const std::string &directory, const std::string &name) {
+        if(directory.empty()) return name;
+
+        char last = directory[directory.size() - 1];
+        if((last == '/') || (last == '\\')) return directory + name;
+        return directory + "/" + name;
+    }
+
+    // Paths on Windows are not case sensitive and use both separators,
+    // so they're compared after being converted to lower case and '\\'.
+    static std::string NormalizePath(const std::string &path) {
+#ifdef _WIN32
+        std::string normalized(path);
+
+        for(size_t i = 0; i < normalized.size(); i++) {
+            char c = normalized[i];
+            normalized[i] = (c == '/') ? '\\' : (char)tolower((unsigned char)c);
+        }
+
+        return normalized;
+#else
+        return path;
+#endif
+    }
+
+    // Streams use wide paths; the narrow ones are converted using the current locale.
+    static bool WidePath(const std::string &path, wchar_t *widePath, size_t size) {
+        size_t length = mbstowcs(widePath, path.c_str(), size);
+        return (length != (size_t)-1) && (length < size);
+    }
+
+    static double ElapsedMs(Clock::time_point start) {
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        return elapsed.count();
+    }
+};
+
+#endif
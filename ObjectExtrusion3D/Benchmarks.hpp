@@ -0,0 +1,647 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BENCHMARKS_HPP
+#define BENCHMARKS_HPP
+
+#define _USE_MATH_DEFINES
+#include "Point.hpp"
+#include "List.hpp"
+#include "Stream.hpp"
+#include "Shape.hpp"
+#include "BasicShapes.hpp"
+#include "RotateAction.hpp"
+#include "TranslateAction.hpp"
+#include "ScaleAction.hpp"
+#include "IAction.hpp"
+#include "Storyboard.hpp"
+#include "FrameStore.hpp"
+#include "Transform.hpp"
+#include "TransformKernel.hpp"
+#include "ThreadPool.hpp"
+#include "BezierShape.hpp"
+#include "Scene.hpp"
+#include "FrameCodec.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <math.h>
+
+// Counts the heap allocations made by the program, so that the benchmarks
+// can report them. Like the tests, this header should be included
+// by a single translation unit.
+static std::atomic<size_t> allocationCount_(0);
+
+void* operator new(size_t size) {
+    allocationCount_++;
+    void *memory = malloc(size == 0 ? 1 : size);
+
+    if(memory == NULL) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *memory) throw() {
+    free(memory);
+}
+
+void operator delete[](void *memory) throw() {
+    free(memory);
+}
+
+double ElapsedMilliseconds(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+void BenchmarkFrameAllocations() {
+    const int STEPS = 100;
+    const int POINTS = 2000;
+    const int RUNS = 10;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+
+    // Before: each step copied the previous frame into a new list.
+    size_t allocations = allocationCount_;
+    clock_t start = clock();
+
+    for(int run = 0; run < RUNS; run++) {
+        List<List<Point> *> frames;
+        frames.Add(new List<Point>(shape->Points()));
+
+        for(int i = 0; i < STEPS; i++) {
+            List<Point> *points = new List<Point>(*frames[frames.Count() - 1]);
+            frames.Add(points);
+
+            Frame frame(*points);
+            action->Execute(i, frame);
+        }
+
+        for(size_t i = 0; i < frames.Count(); i++) {
+            delete frames[i];
+        }
+    }
+
+    printf("Frame allocation, %d steps x %d points:\n", STEPS, POINTS);
+    printf("    list per frame: %u allocations/play, %.2f ms/play\n",
+           (unsigned)((allocationCount_ - allocations) / RUNS),
+           ElapsedMilliseconds(start) / RUNS);
+
+    // After: the frames are views into the storyboard slab.
+    // The first play sizes the slab, the following ones reuse it.
+    sb.Play();
+    sb.Reset();
+
+    allocations = allocationCount_;
+    start = clock();
+
+    for(int run = 0; run < RUNS; run++) {
+        sb.Reset();
+        sb.Play();
+        while(sb.NextStep()) {}
+    }
+
+    printf("    frame store:    %u allocations/play, %.2f ms/play\n",
+           (unsigned)((allocationCount_ - allocations) / RUNS),
+           ElapsedMilliseconds(start) / RUNS);
+
+    // Executing the steps in place on a point buffer.
+    PointBuffer buffer(shape->Points());
+    allocations = allocationCount_;
+    start = clock();
+
+    for(int run = 0; run < RUNS; run++) {
+        action->Initialize(Frame(shape->Points()));
+
+        for(int i = 0; i < STEPS; i++) {
+            action->Execute(i, buffer);
+        }
+    }
+
+    printf("    point buffer:   %u allocations/play, %.2f ms/play\n",
+           (unsigned)((allocationCount_ - allocations) / RUNS),
+           ElapsedMilliseconds(start) / RUNS);
+    delete shape;
+}
+
+// The per-point code RotateAction and TranslateAction executed on each step
+// before the steps were compiled into transforms. It's kept here
+// as the baseline of BenchmarkLinkedActions.
+static void BaselineRotate(List<Point> &points, RotationAxis axis, 
+                           const Point &origin, double step) {
+    for(size_t i = 0; i < points.Count(); i++) {
+        Point &point = points[i];
+
+        switch(axis) {
+            case AXIS_X: {
+                double y = point.Y - origin.Y;
+                double z = point.Z - origin.Z;
+                point.Y = y * cos(step) - z * sin(step) + origin.Y;
+                point.Z = y * sin(step) + z * cos(step) + origin.Z;
+                break;
+            }
+            case AXIS_Y: {
+                double x = point.X - origin.X;
+                double z = point.Z - origin.Z;
+                point.X = z * sin(step) + x * cos(step) + origin.X;
+                point.Z = z * cos(step) - x * sin(step) + origin.Z;
+                break;
+            }
+            case AXIS_Z: {
+                double x = point.X - origin.X;
+                double y = point.Y - origin.Y;
+                point.X = x * cos(step) - y * sin(step) + origin.X;
+                point.Y = x * sin(step) + y * cos(step) + origin.Y;
+                break;
+            }
+        }
+    }
+}
+
+static void BaselineTranslate(List<Point> &points, double dx, double dy, double dz) {
+    for(size_t i = 0; i < points.Count(); i++) {
+        Point &point = points[i];
+        point.X += dx;
+        point.Y += dy;
+        point.Z += dz;
+    }
+}
+
+void BenchmarkLinkedActions() {
+    const int STEPS = 100;
+    const int POINTS = 2000;
+    const int RUNS = 10;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    Storyboard sb;
+    sb.SetShapeObject(shape);
+
+    IAction *actions[] = { new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X),
+                           new TranslateAction(0, 0, 200),
+                           new RotateAction(M_PI / 4, ROTATION_CENTER, AXIS_Z),
+                           new TranslateAction(50, 0, 0) };
+    int count = sizeof(actions) / sizeof(actions[0]);
+
+    for(int i = 0; i < count; i++) {
+        actions[i]->SetSteps(STEPS);
+        actions[i]->SetWithPrevious(i > 0);
+        sb.Actions().Add(actions[i]);
+    }
+
+    // Before: each frame is a copy of the previous one, which each linked
+    // action walks in turn, using the original per-point code of the actions.
+    clock_t start = clock();
+
+    for(int run = 0; run < RUNS; run++) {
+        List<List<Point> *> frames;
+        frames.Add(new List<Point>(shape->Points()));
+        Point center = Point::Centroid(*frames[0]);
+
+        for(int step = 0; step < STEPS; step++) {
+            List<Point> *points = new List<Point>(*frames[frames.Count() - 1]);
+            frames.Add(points);
+            BaselineRotate(*points, AXIS_X, Point(), 2 * M_PI / STEPS);
+            BaselineTranslate(*points, 0, 0, 200.0 / STEPS);
+            BaselineRotate(*points, AXIS_Z, center, M_PI / 4 / STEPS);
+            BaselineTranslate(*points, 50.0 / STEPS, 0, 0);
+        }
+
+        for(size_t i = 0; i < frames.Count(); i++) {
+            delete frames[i];
+        }
+    }
+
+    printf("Linked actions, %d actions x %d steps x %d points:\n", count, STEPS, POINTS);
+    printf("    pass per action:  %.2f ms/play\n", ElapsedMilliseconds(start) / RUNS);
+
+    // After: the steps are composed into one transform per frame.
+    start = clock();
+
+    for(int run = 0; run < RUNS; run++) {
+        sb.Reset();
+        sb.Play();
+        while(sb.NextStep()) {}
+    }
+
+    printf("    compiled steps:   %.2f ms/play\n", ElapsedMilliseconds(start) / RUNS);
+    delete shape;
+}
+
+void BenchmarkTransformKernel() {
+    const size_t SIZES[] = { 1000, 100000, 10000000 };
+    const char *LEVELS[] = { "scalar", "SSE2", "AVX2" };
+    const size_t POINTS_PER_SIZE = 100000000;
+
+    Transform t = Transform::RotationX(0.01, Point(1, 2, 3)) *
+                  Transform::Translation(0.5, 0, 0);
+    KernelLevel supported = TransformKernel::SupportedLevel();
+    printf("Transform kernel (points/second):\n");
+
+    for(int i = 0; i < 3; i++) {
+        // The points are transformed in place, so that the
+        // largest buffer still fits in memory comfortably.
+        size_t count = SIZES[i];
+        size_t runs = POINTS_PER_SIZE / count;
+        double *x = new double[count];
+        double *y = new double[count];
+        double *z = new double[count];
+
+        for(size_t j = 0; j < count; j++) {
+            x[j] = y[j] = z[j] = (double)j;
+        }
+
+        printf("    %8u points:", (unsigned)count);
+
+        for(int level = KERNEL_SCALAR; level <= supported; level++) {
+            TransformKernel::SetLevel((KernelLevel)level);
+            clock_t start = clock();
+
+            for(size_t run = 0; run < runs; run++) {
+                TransformKernel::Apply(t, x, y, z, x, y, z, count);
+            }
+
+            double seconds = ElapsedMilliseconds(start) / 1000.0;
+            printf("  %s %.0fM", LEVELS[level], (runs * count) / seconds / 1e6);
+        }
+
+        printf("\n");
+        delete[] x;
+        delete[] y;
+        delete[] z;
+    }
+
+    TransformKernel::SetLevel(supported);
+}
+
+// The Bezier evaluation BezierShape used before forward differencing.
+static void PowBezierCurve(const Point &anchor1, const Point &anchor2,
+                           const Point &control1, const Point &control2,
+                           int count, Point *points) {
+    double u = 0;
+    double stepU = 1.0 / (count - 1);
+
+    for(int i = 0; i < count; i++) {
+        double x = pow(u,3)*(anchor2.X+3*(control1.X-control2.X)-anchor1.X) +
+                   3*pow(u,2)*(anchor1.X-2*control1.X+control2.X) +
+                   3*u*(control1.X-anchor1.X)+anchor1.X;
+
+        double y = pow(u,3)*(anchor2.Y+3*(control1.Y-control2.Y)-anchor1.Y) +
+                   3*pow(u,2)*(anchor1.Y-2*control1.Y+control2.Y) +
+                   3*u*(control1.Y-anchor1.Y)+anchor1.Y;
+
+        points[i] = Point(x, y);
+        u += stepU;
+    }
+}
+
+void BenchmarkBezierEvaluation() {
+    const int SEGMENTS = 4000000;
+    const int POINTS_PER_SEGMENT = 10;
+    Point points[POINTS_PER_SEGMENT];
+    double checksum = 0;
+
+    printf("Bezier evaluation, %d segments x %d points:\n", SEGMENTS, POINTS_PER_SEGMENT);
+    clock_t start = clock();
+
+    for(int i = 0; i < SEGMENTS; i++) {
+        PowBezierCurve(Point(i, 0), Point(i + 10, 5), Point(i + 3, 20), 
+                       Point(i + 7, -20), POINTS_PER_SEGMENT, points);
+        checksum += points[POINTS_PER_SEGMENT / 2].X;
+    }
+
+    printf("    pow:                 %.0f ms\n", ElapsedMilliseconds(start));
+    start = clock();
+
+    for(int i = 0; i < SEGMENTS; i++) {
+        BezierShape::EvaluateCurve(Point(i, 0), Point(i + 10, 5), Point(i + 3, 20), 
+                                   Point(i + 7, -20), POINTS_PER_SEGMENT, points);
+        checksum += points[POINTS_PER_SEGMENT / 2].X;
+    }
+
+    // The checksum keeps the compiler from removing the loops.
+    printf("    forward differences: %.0f ms (%g)\n", ElapsedMilliseconds(start), checksum);
+}
+
+void BenchmarkParallelFrames() {
+    const int STEPS = 500;
+    const int POINTS = 10000;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+
+    // The first run only sizes the frame store.
+    printf("Frame generation, %d steps x %d points:\n", STEPS, POINTS);
+    sb.GenerateFrames();
+    sb.Reset();
+
+    clock_t start = clock();
+    sb.GenerateFrames();
+    printf("    serial:     %.2f ms\n", ElapsedMilliseconds(start));
+
+    for(size_t threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2) {
+        // clock() measures processor time on some platforms,
+        // so the wall time is measured instead.
+        ThreadPool pool(threads);
+        sb.Reset();
+
+        std::chrono::high_resolution_clock::time_point begin = 
+            std::chrono::high_resolution_clock::now();
+        sb.GenerateFrames(&pool);
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+
+        printf("    %2u threads: %.2f ms\n", (unsigned)threads, elapsed);
+    }
+
+    delete shape;
+}
+
+void BenchmarkChunkedExecute() {
+    const int STEPS = 20;
+    const int POINTS = 500000;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+
+    List<Point> points(shape->Points());
+    Frame frame(points);
+    action->Initialize(frame);
+    printf("Action execution, %d steps x %d points:\n", STEPS, POINTS);
+
+    // Thread count 0 stands for executing without a pool.
+    for(size_t threads = 0; threads <= std::thread::hardware_concurrency(); 
+        threads = std::max((size_t)1, threads * 2)) {
+        ThreadPool *pool = threads > 0 ? new ThreadPool(threads) : NULL;
+
+        std::chrono::high_resolution_clock::time_point begin = 
+            std::chrono::high_resolution_clock::now();
+
+        for(int step = 0; step < STEPS; step++) {
+            action->Execute(step, frame, pool);
+        }
+
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+        printf("    %2u threads: %.2f ms\n", (unsigned)threads, elapsed);
+        delete pool;
+    }
+
+    delete action;
+    delete shape;
+}
+
+void BenchmarkStream() {
+    const int POINTS = 1000000;
+    List<Point> points(POINTS);
+
+    for(int i = 0; i < POINTS; i++) {
+        points.Add(Point(i, i * 0.5, i * 0.25));
+    }
+
+    printf("Serialization of %d points:\n", POINTS);
+    std::chrono::high_resolution_clock::time_point begin = 
+        std::chrono::high_resolution_clock::now();
+    {
+        Stream stream(L"benchmark.dat", true);
+        points.Serialize(stream);
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - begin).count();
+    printf("    write: %.2f ms\n", elapsed);
+
+    begin = std::chrono::high_resolution_clock::now();
+    {
+        Stream stream(L"benchmark.dat");
+        points.Deserialize(stream);
+    }
+
+    elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - begin).count();
+    printf("    read:  %.2f ms\n", elapsed);
+}
+
+void BenchmarkFrameCache() {
+    const int STEPS = 500;
+    const int POINTS = 10000;
+
+    Scene scene;
+    scene.SetShape(ShapeGenerator::Circle(100, POINTS));
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+    scene.Storyboard().Actions().Add(action);
+
+    scene.Save(L"benchmark.scn");
+    scene.Save(L"benchmark_cached.scn", true);
+    printf("Opening a scene with its frames, %d steps x %d points:\n", STEPS, POINTS);
+
+    std::chrono::high_resolution_clock::time_point begin = 
+        std::chrono::high_resolution_clock::now();
+    {
+        Scene opened;
+        opened.Open(L"benchmark.scn");
+        opened.Storyboard().GenerateFrames();
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - begin).count();
+    printf("    generated: %.2f ms\n", elapsed);
+
+    begin = std::chrono::high_resolution_clock::now();
+    {
+        Scene opened;
+        opened.Open(L"benchmark_cached.scn");
+    }
+
+    elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - begin).count();
+    printf("    cached:    %.2f ms\n", elapsed);
+}
+
+void BenchmarkFrameCodec() {
+    const int STEPS = 500;
+    const int POINTS = 10000;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+    sb.GenerateFrames();
+    FrameStore &frames = sb.Frames();
+    List<Point> points;
+
+    for(size_t i = 0; i < frames.Count(); i++) {
+        points.Add(frames[i].Data(), (int)frames.PointCount());
+    }
+
+    printf("Frame compression, %d steps x %d points:\n", STEPS, POINTS);
+    {
+        Stream stream(L"benchmark.dat", true);
+        points.Serialize(stream);
+    }
+
+    std::chrono::high_resolution_clock::time_point begin = 
+        std::chrono::high_resolution_clock::now();
+    {
+        Stream stream(L"benchmark.dat");
+        points.Deserialize(stream);
+        printf("    raw:     %.1f MB, read %.2f ms\n", stream.Size() / 1048576.0,
+               std::chrono::duration<double, std::milli>(
+                   std::chrono::high_resolution_clock::now() - begin).count());
+    }
+
+    const double tolerances[] = { 1e-2, 1e-3, 1e-4 };
+
+    for(int i = 0; i < 3; i++) {
+        begin = std::chrono::high_resolution_clock::now();
+        {
+            Stream stream(L"benchmark.dat", true);
+            stream.Write(FrameCodec(frames, tolerances[i]));
+        }
+
+        double encodeTime = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        FrameStore decoded;
+        FrameCodec codec(decoded);
+        Stream stream(L"benchmark.dat");
+        stream.Read(codec);
+
+        double decodeTime = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+        printf("    tolerance %g: %.1f MB (%.1fx smaller), write %.2f ms, read %.2f ms\n",
+               tolerances[i], stream.Size() / 1048576.0, 
+               points.Count() * 3 * sizeof(double) / (double)stream.Size(),
+               encodeTime, decodeTime);
+    }
+
+    delete shape;
+}
+
+void BenchmarkFloatPipeline() {
+    const int STEPS = 500;
+    const int POINTS = 10000;
+    const size_t KERNEL_POINTS = 1000000;
+    const int KERNEL_RUNS = 100;
+
+    Shape *shape = ShapeGenerator::Circle(100, POINTS);
+    IAction *action = new RotateAction(2 * M_PI, ROTATION_ZERO, AXIS_X);
+    action->SetSteps(STEPS);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+    sb.GenerateFrames(); // Allocates the frames.
+    FrameStoreF frames;
+    sb.GenerateFrames(frames);
+
+    printf("Float pipeline, %d steps x %d points:\n", STEPS, POINTS);
+    clock_t start = clock();
+    sb.GenerateFrames();
+    double generateTime = ElapsedMilliseconds(start);
+
+    start = clock();
+    MeshBuilder builder;
+    builder.Update(sb.Frames());
+    double meshTime = ElapsedMilliseconds(start);
+    printf("    double: generate %.1f ms, mesh %.1f ms, %.1f MB of frames\n", 
+           generateTime, meshTime, 
+           sb.Frames().Count() * sb.Frames().PointCount() * sizeof(Point) / 1048576.0);
+
+    start = clock();
+    sb.GenerateFrames(frames);
+    generateTime = ElapsedMilliseconds(start);
+
+    start = clock();
+    MeshBuilderF builderF;
+    builderF.Update(frames);
+    meshTime = ElapsedMilliseconds(start);
+    printf("    float:  generate %.1f ms, mesh %.1f ms, %.1f MB of frames\n", 
+           generateTime, meshTime, 
+           frames.Count() * frames.PointCount() * sizeof(PointF) / 1048576.0);
+
+    // The SoA kernel on both precisions.
+    Transform t = Transform::RotationX(0.01, Point(1, 2, 3));
+    PointBuffer buffer(KERNEL_POINTS);
+    PointBufferF bufferF(KERNEL_POINTS);
+    buffer.Resize(KERNEL_POINTS);
+    bufferF.Resize(KERNEL_POINTS);
+
+    for(size_t i = 0; i < KERNEL_POINTS; i++) {
+        buffer.Set(i, Point((double)i, 1, 2));
+        bufferF.Set(i, Point((double)i, 1, 2));
+    }
+
+    start = clock();
+    for(int run = 0; run < KERNEL_RUNS; run++) {
+        buffer.Apply(t);
+    }
+
+    double doubleTime = ElapsedMilliseconds(start) / 1000.0;
+    start = clock();
+
+    for(int run = 0; run < KERNEL_RUNS; run++) {
+        bufferF.Apply(t);
+    }
+
+    double floatTime = ElapsedMilliseconds(start) / 1000.0;
+    printf("    kernel, %u points: double %.0fM, float %.0fM points/second\n", 
+           (unsigned)KERNEL_POINTS, KERNEL_RUNS * KERNEL_POINTS / doubleTime / 1e6,
+           KERNEL_RUNS * KERNEL_POINTS / floatTime / 1e6);
+    delete shape;
+}
+
+#endif
@@ -37,23 +37,35 @@
 #include "List.hpp"
 #include "ISerializable.hpp"
 #include "Stream.hpp"
+#include <utility>
 
 class BezierShape : public Shape {
 private:
     static const int POINTS_PER_LINE = 10;
     static const int DEFAULT_POINTS = 32;
+    static const int MAX_SUBDIVISIONS = 16;
 
     List<Point> anchorPoints_;
     List<Point> controlPoints_;
+    double tolerance_;
+    // The anchor and control points each segment was last tessellated with,
+    // four for each segment. Used to find the segments which changed.
+    List<Point> segmentPoints_;
+    List<size_t> segmentStarts_; // Where the points of each segment start.
+    List<Point> scratch_;
 
 public:
     //
     // Constructors / destructor.
     //
-    BezierShape() {}
+    BezierShape() : tolerance_(0) {}
 
-    BezierShape(const List<Point> anchPoints, const List<Point> ctrlPoints) :
-        anchorPoints_(anchPoints), controlPoints_(ctrlPoints){}
+    BezierShape(const List<Point> &anchPoints, const List<Point> &ctrlPoints) :
+        anchorPoints_(anchPoints), controlPoints_(ctrlPoints), tolerance_(0) {}
+
+    BezierShape(List<Point> &&anchPoints, List<Point> &&ctrlPoints) :
+        anchorPoints_(std::move(anchPoints)), controlPoints_(std::move(ctrlPoints)), 
+        tolerance_(0) {}
 
     virtual ~BezierShape() {}
 
@@ -80,17 +92,73 @@ public:
         return controlPoints_.Count();
     }
 
+    double Tolerance() const {
+        return tolerance_;
+    }
+
+    // Sets the maximum distance between the curves and the lines
+    // connecting their points. The curves are subdivided until it's met,
+    // so the number of points depends on their curvature. With 0, each curve
+    // is evaluated at POINTS_PER_LINE evenly spaced points.
+    void SetTolerance(double value) {
+        tolerance_ = value;
+        segmentPoints_.Clear();
+        segmentStarts_.Clear();
+    }
+
+    // Returns the points of the AnchorCount - 1 Bezier curves.
+    // The points are cached and only the curves whose anchor 
+    // or control points changed since the last call are evaluated again.
     virtual List<Point>& Points() {
-        points_.Clear();
-        
-        if(anchorPoints_.Count() < 2) {
+        size_t segments = anchorPoints_.Count() < 2 ? 0 : anchorPoints_.Count() - 1;
+        if(segmentStarts_.Count() == 0) segmentStarts_.Add(0);
+
+        // Drop the segments which were removed.
+        size_t cached = std::min(segments, segmentStarts_.Count() - 1);
+        segmentPoints_.Truncate(cached * 4);
+        segmentStarts_.Truncate(cached + 1);
+        points_.Truncate(segmentStarts_[cached]);
+
+        size_t first = 0;
+        while((first < cached) && !SegmentChanged(first)) {
+            first++;
+        }
+
+        if(first == segments) {
             return points_;
         }
 
-        // Se adauga la lista AnchorCount - 1 curbe Bezier.
-        for(size_t i = 0; i < anchorPoints_.Count() - 1; i++) {
-            AddBezierPoints(anchorPoints_[i], anchorPoints_[i + 1],
-                            controlPoints_[2*i], controlPoints_[2*i + 1]);
+        // The number of points of a changed segment can be different, so the
+        // points of the segments after it are moved to their new position.
+        size_t tailStart = segmentStarts_[first];
+        size_t oldStart = tailStart;
+        scratch_.Clear();
+        scratch_.Add(points_.Data() + tailStart, (int)(points_.Count() - tailStart));
+        points_.Truncate(tailStart);
+
+        for(size_t i = first; i < segments; i++) {
+            if((i < cached) && !SegmentChanged(i)) {
+                size_t oldEnd = segmentStarts_[i + 1];
+                points_.Add(scratch_.Data() + (oldStart - tailStart), (int)(oldEnd - oldStart));
+                oldStart = oldEnd;
+            }
+            else {
+                if(i < cached) {
+                    oldStart = segmentStarts_[i + 1];
+                }
+                else {
+                    for(int j = 0; j < 4; j++) {
+                        segmentPoints_.Add(Point());
+                    }
+
+                    segmentStarts_.Add(0);
+                }
+
+                SetSegmentPoints(i);
+                TessellateSegment(i, points_);
+            }
+
+            segmentStarts_[i + 1] = points_.Count();
         }
 
         return points_;
@@ -124,23 +192,146 @@ public:
         stream.Read(controlPoints_);
     }
 
-    void AddBezierPoints(const Point &anchor1, const Point &anchor2,
-                         const Point &control1, const Point &control2) {
-        double u = 0;
-        double stepU = 1.0 / (POINTS_PER_LINE - 1);
+    // Appends the points of the curve, subdivided until no piece deviates
+    // from the line between its ends by more than 'tolerance'.
+    // Both end points of the curve are included.
+    static void TessellateCurve(const Point &anchor1, const Point &anchor2,
+                                const Point &control1, const Point &control2,
+                                double tolerance, List<Point> &points) {
+        assert(tolerance > 0);
+        // --------------------------------
+        points.Add(Point(anchor1.X, anchor1.Y));
+        SubdivideCurve(anchor1, control1, control2, anchor2, tolerance, 0, points);
+    }
+
+    // Writes 'count' points evenly spaced in the curve parameter to 'points'.
+    // The curve is evaluated by forward differencing: the cubic polynomial
+    // (in power form) is stepped using its first three differences, 
+    // so each point costs just a few additions.
+    static void EvaluateCurve(const Point &anchor1, const Point &anchor2,
+                              const Point &control1, const Point &control2,
+                              int count, Point *points) {
+        assert(count >= 2);
+        // --------------------------------
+        double h = 1.0 / (count - 1);
+        double h2 = h * h;
+        double h3 = h2 * h;
+
+        // P(u) = a*u^3 + b*u^2 + c*u + d
+        double ax = anchor2.X + 3 * (control1.X - control2.X) - anchor1.X;
+        double bx = 3 * (anchor1.X - 2 * control1.X + control2.X);
+        double cx = 3 * (control1.X - anchor1.X);
+        double ay = anchor2.Y + 3 * (control1.Y - control2.Y) - anchor1.Y;
+        double by = 3 * (anchor1.Y - 2 * control1.Y + control2.Y);
+        double cy = 3 * (control1.Y - anchor1.Y);
+
+        double x = anchor1.X;
+        double dx = ax * h3 + bx * h2 + cx * h;
+        double ddx = 6 * ax * h3 + 2 * bx * h2;
+        double dddx = 6 * ax * h3;
+        double y = anchor1.Y;
+        double dy = ay * h3 + by * h2 + cy * h;
+        double ddy = 6 * ay * h3 + 2 * by * h2;
+        double dddy = 6 * ay * h3;
+
+        for(int i = 0; i < count; i++) {
+            points[i] = Point(x, y);
+            x += dx;
+            dx += ddx;
+            ddx += dddx;
+            y += dy;
+            dy += ddy;
+            ddy += dddy;
+        }
+    }
+
+private:
+    bool SegmentChanged(size_t segment) const {
+        const Point *last = &segmentPoints_[segment * 4];
+        return !SamePoint(last[0], anchorPoints_[segment])     ||
+               !SamePoint(last[1], anchorPoints_[segment + 1]) ||
+               !SamePoint(last[2], controlPoints_[2 * segment])  ||
+               !SamePoint(last[3], controlPoints_[2 * segment + 1]);
+    }
+
+    void SetSegmentPoints(size_t segment) {
+        Point *last = &segmentPoints_[segment * 4];
+        last[0] = anchorPoints_[segment];
+        last[1] = anchorPoints_[segment + 1];
+        last[2] = controlPoints_[2 * segment];
+        last[3] = controlPoints_[2 * segment + 1];
+    }
+
+    static bool SamePoint(const Point &a, const Point &b) {
+        // Even the smallest move must invalidate the cached points.
+        return (a.X == b.X) && (a.Y == b.Y) && (a.Z == b.Z);
+    }
+
+    // Appends the points of the given segment.
+    void TessellateSegment(size_t segment, List<Point> &points) {
+        const Point &anchor1 = anchorPoints_[segment];
+        const Point &anchor2 = anchorPoints_[segment + 1];
+        const Point &control1 = controlPoints_[2 * segment];
+        const Point &control2 = controlPoints_[2 * segment + 1];
+
+        if(tolerance_ > 0) {
+            TessellateCurve(anchor1, anchor2, control1, control2, tolerance_, points);
+            return;
+        }
+
+        size_t start = points.Count();
+
+        for(int i = 0; i < POINTS_PER_LINE; i++) {
+            points.Add(Point());
+        }
 
-        for(size_t i = 0; i < POINTS_PER_LINE; i++) {
-            double x = pow(u,3)*(anchor2.X+3*(control1.X-control2.X)-anchor1.X) +
-                       3*pow(u,2)*(anchor1.X-2*control1.X+control2.X) +
-                       3*u*(control1.X-anchor1.X)+anchor1.X;
+        EvaluateCurve(anchor1, anchor2, control1, control2, 
+                      POINTS_PER_LINE, points.Data() + start);
+    }
 
-            double y = pow(u,3)*(anchor2.Y+3*(control1.Y-control2.Y)-anchor1.Y) +
-                       3*pow(u,2)*(anchor1.Y-2*control1.Y+control2.Y) +
-                       3*u*(control1.Y-anchor1.Y)+anchor1.Y;
-          
-            points_.Add(Point(x, y));
-            u += stepU;
+    // The curve lies inside the convex hull of its control points, so if they 
+    // are close enough to the chord, the whole curve is. Otherwise the curve
+    // is split in half (de Casteljau) and each half is tested again.
+    static void SubdivideCurve(const Point &p0, const Point &p1, const Point &p2, 
+                               const Point &p3, double tolerance, int depth, 
+                               List<Point> &points) {
+        if((depth == MAX_SUBDIVISIONS) ||
+           ((ChordDistance(p1, p0, p3) <= tolerance) && 
+            (ChordDistance(p2, p0, p3) <= tolerance))) {
+            points.Add(Point(p3.X, p3.Y));
+            return;
         }
+
+        Point p01 = Middle(p0, p1);
+        Point p12 = Middle(p1, p2);
+        Point p23 = Middle(p2, p3);
+        Point p012 = Middle(p01, p12);
+        Point p123 = Middle(p12, p23);
+        Point p0123 = Middle(p012, p123);
+
+        SubdivideCurve(p0, p01, p012, p0123, tolerance, depth + 1, points);
+        SubdivideCurve(p0123, p123, p23, p3, tolerance, depth + 1, points);
+    }
+
+    static Point Middle(const Point &a, const Point &b) {
+        return Point((a.X + b.X) / 2, (a.Y + b.Y) / 2);
+    }
+
+    // Returns the distance between 'point' and the segment from 'a' to 'b'.
+    static double ChordDistance(const Point &point, const Point &a, const Point &b) {
+        double dx = b.X - a.X;
+        double dy = b.Y - a.Y;
+        double length = dx * dx + dy * dy;
+        double t = 0;
+
+        if(length > 0) {
+            t = ((point.X - a.X) * dx + (point.Y - a.Y) * dy) / length;
+            t = std::max(0.0, std::min(1.0, t));
+        }
+
+        double x = point.X - (a.X + t * dx);
+        double y = point.Y - (a.Y + t * dy);
+        return sqrt(x * x + y * y);
     }
 };
 
@@ -0,0 +1,122 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FRAME_CACHE_HPP
+#define FRAME_CACHE_HPP
+
+#include "FrameStore.hpp"
+#include "FrameCodec.hpp"
+#include "SceneContainer.hpp"
+#include "Stream.hpp"
+#include <cstdlib>
+#include <algorithm>
+
+// Stores the frames generated by a storyboard in a compact form, so a scene
+// can be saved together with its animation and shown without evaluating it.
+// The frames are compressed by FrameCodec; by default no coordinate changes
+// by more than TOLERANCE times the size of the bounding box of the frames.
+// The frames are valid only for the shape and actions they were generated from,
+// which are identified by a key computed from their saved form.
+class FrameCache {
+public:
+    // Caches written with an older encoding are ignored (and written again).
+    static const int ENCODING;
+    static const double TOLERANCE;
+
+public:
+    //
+    // Public methods.
+    //
+    // Computes the key from the streams to which the shape
+    // and the storyboard were written.
+    static unsigned int Key(const Stream &shape, const Stream &storyboard) {
+        unsigned int crc = Crc32::Compute(shape.Data(), shape.Size());
+        return Crc32::Compute(storyboard.Data(), storyboard.Size(), crc);
+    }
+
+    // 'tolerance' is the largest change of a coordinate allowed;
+    // if it's 0 the default one (relative to the size of the frames) is used.
+    static void Write(FrameStore &frames, unsigned int key, Stream &stream, 
+                      double tolerance = 0) {
+        if(tolerance <= 0) {
+            tolerance = DefaultTolerance(frames);
+        }
+
+        stream.Write(ENCODING);
+        stream.Write((int)key);
+        stream.Write(FrameCodec(frames, tolerance));
+    }
+
+    // Reads the frames into the store, replacing the ones found in it.
+    // Returns false (and leaves the store empty) if the frames
+    // were written for another key or can't be read.
+    static bool Read(Stream &stream, unsigned int key, FrameStore &frames) {
+        frames.Clear();
+        int encoding;
+        int storedKey;
+        stream.Read(encoding);
+        stream.Read(storedKey);
+
+        if(stream.Failed() || (encoding != ENCODING) || ((unsigned int)storedKey != key)) {
+            return false;
+        }
+
+        FrameCodec codec(frames);
+        stream.Read(codec);
+
+        if(stream.Failed() || (frames.Count() == 0)) {
+            frames.Clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    static double DefaultTolerance(const FrameStore &frames) {
+        double minimum[3];
+        double maximum[3];
+        double extent = 0;
+        FrameCodec::Bounds(frames, minimum, maximum);
+
+        for(int axis = 0; axis < 3; axis++) {
+            extent = std::max(extent, maximum[axis] - minimum[axis]);
+        }
+
+        // Frames made of a single point still need a grid.
+        return extent > 0 ? extent * TOLERANCE : TOLERANCE;
+    }
+};
+
+const int FrameCache::ENCODING = 2;
+const double FrameCache::TOLERANCE = 1e-5;
+
+#endif
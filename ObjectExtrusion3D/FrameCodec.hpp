@@ -0,0 +1,542 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include "FrameStore.hpp"
+#include "ISerializable.hpp"
+#include "Stream.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Compresses the frames of a store. It's written and read like any
+// serializable object: stream.Write(FrameCodec(frames, tolerance))
+// encodes the frames, stream.Read(codec) decodes them into its store.
+//
+// The coordinates are rounded to a grid with a step of twice the tolerance,
+// so no coordinate changes by more than the tolerance. Each frame is then
+// predicted from the previous two (the points are assumed to continue moving
+// like they did between them), and only the difference to the prediction
+// is stored. For smooth animations the differences are a few grid steps,
+// so they are stored with Rice codes: each block of values gets the number
+// of low bits which are stored as they are, and the rest of each value
+// is stored as a unary number.
+class FrameCodec : public ISerializable {
+private:
+    // Collects codes of up to 32 bits, least significant bit first.
+    class BitWriter {
+    private:
+        std::vector<unsigned char> &bytes_;
+        unsigned long long buffer_;
+        int count_;
+
+    public:
+        BitWriter(std::vector<unsigned char> &bytes) : 
+                bytes_(bytes), buffer_(0), count_(0) {}
+
+        void Write(unsigned long long value, int bits) {
+            assert(bits <= 32);
+            // --------------------------------
+            buffer_ |= (value & ((1ULL << bits) - 1)) << count_;
+            count_ += bits;
+
+            if(count_ >= 32) {
+                unsigned char word[4] = { (unsigned char)buffer_, (unsigned char)(buffer_ >> 8),
+                                          (unsigned char)(buffer_ >> 16), (unsigned char)(buffer_ >> 24) };
+                bytes_.insert(bytes_.end(), word, word + 4);
+                buffer_ >>= 32;
+                count_ -= 32;
+            }
+        }
+
+        void Flush() {
+            while(count_ > 0) {
+                bytes_.push_back((unsigned char)buffer_);
+                buffer_ >>= 8;
+                count_ -= 8;
+            }
+
+            buffer_ = 0;
+            count_ = 0;
+        }
+    };
+
+    // Reads the codes written by BitWriter. Reading past the end gives zeros.
+    class BitReader {
+    private:
+        const unsigned char *bytes_;
+        size_t size_;
+        size_t position_;
+        unsigned long long buffer_;
+        int count_;
+        int padding_; // The zero bits added to the buffer after the end.
+        bool failed_;
+
+    public:
+        // At least this many bits can be used after a refill.
+        static const int REFILL_BITS = 56;
+
+        BitReader(const unsigned char *bytes, size_t size) : 
+                bytes_(bytes), size_(size), position_(0), 
+                buffer_(0), count_(0), padding_(0), failed_(false) {}
+
+        bool Failed() const {
+            return failed_;
+        }
+
+        void Refill() {
+            if(position_ + 8 <= size_) {
+                // Load a whole word and keep the bytes which fit (little endian).
+                unsigned long long word;
+                memcpy(&word, bytes_ + position_, 8);
+                buffer_ |= word << count_;
+                position_ += (63 - count_) >> 3;
+                count_ |= REFILL_BITS;
+                return;
+            }
+
+            while(count_ <= REFILL_BITS) {
+                if(position_ < size_) {
+                    buffer_ |= (unsigned long long)bytes_[position_++] << count_;
+                }
+                else {
+                    padding_ += 8;
+                }
+
+                count_ += 8;
+            }
+        }
+
+        // Returns the bits in the buffer, which must have been refilled.
+        unsigned long long Bits() const {
+            return buffer_;
+        }
+
+        void Skip(int bits) {
+            buffer_ >>= bits;
+            count_ -= bits;
+
+            if(count_ < padding_) {
+                failed_ = true;
+                padding_ = count_;
+            }
+        }
+
+        unsigned long long Read(int bits) {
+            assert(bits <= 32);
+            // --------------------------------
+            if(count_ < bits) Refill();
+
+            unsigned long long value = buffer_ & ((1ULL << bits) - 1);
+            Skip(bits);
+            return value;
+        }
+    };
+
+public:
+    // The number of values which share the same Rice parameter.
+    static const size_t BLOCK_SIZE;
+    // Unary parts of this length are followed by the value stored as it is.
+    static const int ESCAPE_LENGTH;
+    // The Rice parameter marking a block made only of zeros.
+    static const int ZERO_BLOCK;
+    // The largest Rice parameter; with the unary part it must fit in a refill.
+    static const int MAX_PARAMETER;
+    // The tolerance is increased if the grid would need
+    // more than this many bits for the coordinates.
+    static const int MAX_GRID_BITS;
+
+private:
+    FrameStore *frames_;
+    double tolerance_;
+
+public:
+    //
+    // Constructors.
+    //
+    // 'tolerance' is the largest change of a coordinate allowed
+    // when encoding; it isn't needed for decoding.
+    FrameCodec(FrameStore &frames, double tolerance = 0) : 
+            frames_(&frames), tolerance_(tolerance) {}
+
+    //
+    // Public methods.
+    //
+    double Tolerance() const {
+        return tolerance_;
+    }
+
+    // Computes the smallest and largest coordinates of the points.
+    static void Bounds(const FrameStore &frames, double minimum[3], double maximum[3]) {
+        for(int axis = 0; axis < 3; axis++) {
+            minimum[axis] = HUGE_VAL;
+            maximum[axis] = -HUGE_VAL;
+        }
+
+        for(size_t i = 0; i < frames.Count(); i++) {
+            Frame frame = frames[i];
+
+            for(size_t j = 0; j < frame.Count(); j++) {
+                const Point &point = frame[j];
+                minimum[0] = std::min(minimum[0], point.X);
+                minimum[1] = std::min(minimum[1], point.Y);
+                minimum[2] = std::min(minimum[2], point.Z);
+                maximum[0] = std::max(maximum[0], point.X);
+                maximum[1] = std::max(maximum[1], point.Y);
+                maximum[2] = std::max(maximum[2], point.Z);
+            }
+        }
+
+        for(int axis = 0; axis < 3; axis++) {
+            if(minimum[axis] > maximum[axis]) {
+                minimum[axis] = maximum[axis] = 0; // No points.
+            }
+        }
+    }
+
+    //
+    // Serialization.
+    //
+    virtual void Serialize(Stream &stream) const {
+        assert(tolerance_ > 0);
+        // --------------------------------
+        const FrameStore &frames = *frames_;
+        size_t pointCount = frames.PointCount();
+        size_t valueCount = pointCount * 3;
+        double origin[3];
+        double step;
+        Grid(frames, origin, step);
+
+        // Quantize each frame and store its differences to the prediction.
+        // The values of each coordinate are grouped, because they change alike.
+        std::vector<long long> history[2];
+        std::vector<long long> current(valueCount);
+        std::vector<long long> residuals(valueCount);
+        std::vector<unsigned char> bytes;
+        BitWriter writer(bytes);
+
+        // Frames without points are stored as no frames at all.
+        size_t frameCount = (pointCount == 0) ? 0 : frames.Count();
+
+        for(size_t i = 0; i < frameCount; i++) {
+            Frame frame = frames[i];
+
+            for(size_t j = 0; j < pointCount; j++) {
+                const Point &point = frame[j];
+                current[j]                  = Quantize(point.X, origin[0], step);
+                current[pointCount + j]     = Quantize(point.Y, origin[1], step);
+                current[2 * pointCount + j] = Quantize(point.Z, origin[2], step);
+            }
+
+            for(size_t j = 0; j < valueCount; j++) {
+                residuals[j] = current[j];
+            }
+
+            Unpredict(i, residuals, history, pointCount);
+
+            for(size_t first = 0; first < valueCount; first += BLOCK_SIZE) {
+                EncodeBlock(writer, &residuals[first], std::min(BLOCK_SIZE, valueCount - first));
+            }
+
+            history[1].swap(history[0]);
+            history[0].swap(current);
+            current.resize(valueCount);
+        }
+
+        writer.Flush();
+        stream.Write(frameCount);
+        stream.Write(pointCount);
+        stream.WriteArray(origin, 3);
+        stream.Write(step);
+        stream.Write(bytes.size());
+
+        if(!bytes.empty()) {
+            stream.WriteBlock(&bytes[0], bytes.size());
+        }
+    }
+
+    // Replaces the frames of the store with the decoded ones. 
+    // If the data is not valid the store is left empty and the stream fails.
+    virtual void Deserialize(Stream &stream) {
+        FrameStore &frames = *frames_;
+        frames.Clear();
+        size_t frameCount;
+        size_t pointCount;
+        double origin[3];
+        double step;
+        size_t byteCount;
+
+        stream.Read(frameCount);
+        stream.Read(pointCount);
+        stream.ReadArray(origin, 3);
+        stream.Read(step);
+        stream.Read(byteCount);
+
+        // Each block of values takes at least 5 bits,
+        // which limits the size of the frames the data can describe.
+        size_t maxBlocks = byteCount / 5 * 8 + 8;
+        if(stream.Failed() || (byteCount > stream.Remaining()) || 
+           (pointCount > maxBlocks * BLOCK_SIZE / 3)) {
+            stream.SetFailed();
+            return;
+        }
+
+        size_t valueCount = pointCount * 3;
+        size_t blocks = (valueCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if((frameCount > 0) && ((blocks == 0) || (frameCount > maxBlocks / blocks))) {
+            stream.SetFailed();
+            return;
+        }
+
+        std::vector<unsigned char> bytes(byteCount + 1);
+        stream.ReadBlock(&bytes[0], byteCount);
+        BitReader reader(&bytes[0], byteCount);
+
+        std::vector<long long> history[2];
+        std::vector<long long> current(valueCount);
+        frames.Reserve(frameCount, pointCount);
+
+        for(size_t i = 0; (i < frameCount) && !reader.Failed(); i++) {
+            for(size_t first = 0; first < valueCount; first += BLOCK_SIZE) {
+                DecodeBlock(reader, &current[first], std::min(BLOCK_SIZE, valueCount - first));
+            }
+
+            Predict(i, current, history, pointCount);
+            Frame frame = frames.AddFrame();
+            const long long *x = &current[0];
+            const long long *y = x + pointCount;
+            const long long *z = y + pointCount;
+
+            for(size_t j = 0; j < pointCount; j++) {
+                Point &point = frame[j];
+                point.X = origin[0] + x[j] * step;
+                point.Y = origin[1] + y[j] * step;
+                point.Z = origin[2] + z[j] * step;
+            }
+
+            history[1].swap(history[0]);
+            history[0].swap(current);
+            current.resize(valueCount);
+        }
+
+        if(reader.Failed()) {
+            frames.Clear();
+            stream.SetFailed();
+        }
+    }
+
+private:
+    // Computes the corner of the grid (the smallest coordinates)
+    // and the distance between its lines.
+    void Grid(const FrameStore &frames, double origin[3], double &step) const {
+        double maximum[3];
+        double extent = 0;
+        Bounds(frames, origin, maximum);
+
+        for(int axis = 0; axis < 3; axis++) {
+            extent = std::max(extent, maximum[axis] - origin[axis]);
+        }
+
+        step = std::max(2 * tolerance_, extent / (double)(1LL << MAX_GRID_BITS));
+    }
+
+    static long long Quantize(double value, double origin, double step) {
+        return (long long)floor((value - origin) / step + 0.5);
+    }
+
+    // The first frame is predicted from the previous point, the second one
+    // from the first frame, and the others by extending the movement
+    // between the previous two frames. Replaces the values of the frame
+    // with their difference to the prediction.
+    static void Unpredict(size_t frame, std::vector<long long> &values,
+                          const std::vector<long long> history[2], size_t pointCount) {
+        if(frame == 0) {
+            for(size_t axis = 0; axis < 3; axis++) {
+                long long *axisValues = &values[axis * pointCount];
+
+                for(size_t j = pointCount - 1; j > 0; j--) {
+                    axisValues[j] -= axisValues[j - 1];
+                }
+            }
+        }
+        else if(frame == 1) {
+            for(size_t j = 0; j < values.size(); j++) {
+                values[j] -= history[0][j];
+            }
+        }
+        else {
+            for(size_t j = 0; j < values.size(); j++) {
+                values[j] -= 2 * history[0][j] - history[1][j];
+            }
+        }
+    }
+
+    // Replaces the differences with the values, the reverse of Unpredict.
+    static void Predict(size_t frame, std::vector<long long> &values,
+                        const std::vector<long long> history[2], size_t pointCount) {
+        if(frame == 0) {
+            for(size_t axis = 0; axis < 3; axis++) {
+                long long *axisValues = &values[axis * pointCount];
+
+                for(size_t j = 1; j < pointCount; j++) {
+                    axisValues[j] += axisValues[j - 1];
+                }
+            }
+        }
+        else if(frame == 1) {
+            for(size_t j = 0; j < values.size(); j++) {
+                values[j] += history[0][j];
+            }
+        }
+        else {
+            for(size_t j = 0; j < values.size(); j++) {
+                values[j] += 2 * history[0][j] - history[1][j];
+            }
+        }
+    }
+
+    // Maps signed values to unsigned ones, small magnitudes first (0, -1, 1, -2...).
+    static unsigned long long ZigZag(long long value) {
+        return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+    }
+
+    static long long UnZigZag(unsigned long long value) {
+        return (long long)(value >> 1) ^ -(long long)(value & 1);
+    }
+
+    // Returns the number of consecutive one bits at the start of 'bits',
+    // at most ESCAPE_LENGTH.
+    static int CountOnes(unsigned long long bits) {
+        unsigned int zeros = ~(unsigned int)bits | (1U << ESCAPE_LENGTH);
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, zeros);
+        return (int)index;
+#else
+        return __builtin_ctz(zeros);
+#endif
+    }
+
+    static void EncodeBlock(BitWriter &writer, const long long *residuals, size_t count) {
+        unsigned long long values[64];
+        unsigned long long sum = 0;
+
+        for(size_t i = 0; i < count; i++) {
+            values[i] = ZigZag(residuals[i]);
+            sum += std::min(values[i], 1ULL << 40);
+        }
+
+        if(sum == 0) {
+            writer.Write(ZERO_BLOCK, 5);
+            return;
+        }
+
+        // Choose the parameter from the average value; values around it
+        // then take about parameter + 2 bits.
+        int parameter = 0;
+        while((parameter < MAX_PARAMETER) && (((unsigned long long)count << (parameter + 1)) <= sum)) {
+            parameter++;
+        }
+
+        writer.Write(parameter, 5);
+
+        for(size_t i = 0; i < count; i++) {
+            unsigned long long quotient = values[i] >> parameter;
+
+            if(quotient < (unsigned long long)ESCAPE_LENGTH) {
+                writer.Write((1ULL << quotient) - 1, (int)quotient + 1);
+                writer.Write(values[i], parameter);
+            }
+            else {
+                // Too large for a unary number; stored with its length.
+                int length = 0;
+                while((length < 64) && ((values[i] >> length) != 0)) {
+                    length++;
+                }
+
+                writer.Write((1ULL << ESCAPE_LENGTH) - 1, ESCAPE_LENGTH);
+                writer.Write(length, 7);
+                writer.Write(values[i], std::min(length, 32));
+                if(length > 32) writer.Write(values[i] >> 32, length - 32);
+            }
+        }
+    }
+
+    static void DecodeBlock(BitReader &reader, long long *residuals, size_t count) {
+        int parameter = (int)reader.Read(5);
+
+        if(parameter == ZERO_BLOCK) {
+            std::fill(residuals, residuals + count, 0LL);
+            return;
+        }
+
+        parameter = std::min(parameter, MAX_PARAMETER);
+        unsigned long long mask = (1ULL << parameter) - 1;
+
+        for(size_t i = 0; i < count; i++) {
+            reader.Refill();
+            unsigned long long bits = reader.Bits();
+            int quotient = CountOnes(bits);
+
+            if(quotient < ESCAPE_LENGTH) {
+                // The unary part, its end and the low bits fit in a refill.
+                unsigned long long low = (bits >> (quotient + 1)) & mask;
+                reader.Skip(quotient + 1 + parameter);
+                residuals[i] = UnZigZag(((unsigned long long)quotient << parameter) | low);
+            }
+            else {
+                reader.Skip(ESCAPE_LENGTH);
+                int length = std::min((int)reader.Read(7), 64);
+                unsigned long long value = reader.Read(std::min(length, 32));
+                if(length > 32) value |= reader.Read(length - 32) << 32;
+                residuals[i] = UnZigZag(value);
+            }
+        }
+    }
+};
+
+const size_t FrameCodec::BLOCK_SIZE = 64;
+const int FrameCodec::ESCAPE_LENGTH = 24;
+const int FrameCodec::ZERO_BLOCK = 31;
+const int FrameCodec::MAX_PARAMETER = 30;
+const int FrameCodec::MAX_GRID_BITS = 40;
+
+#endif
@@ -0,0 +1,193 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FRAME_STORE_HPP
+#define FRAME_STORE_HPP
+
+#include "Point.hpp"
+#include "List.hpp"
+#include <cstdlib>
+#include <cassert>
+#include <algorithm>
+
+// A non-owning view over a contiguous run of points.
+// Frames are handed out by the FrameStore and point into its slab,
+// so they are cheap to copy and never allocate.
+// The points can be Point (Frame) or PointF (FrameF).
+template <class P>
+class BasicFrame {
+private:
+    P* points_;
+    size_t count_;
+
+public:
+    //
+    // Constructors.
+    //
+    BasicFrame() : points_(NULL), count_(0) {}
+
+    BasicFrame(P* points, size_t count) : points_(points), count_(count) {}
+
+    BasicFrame(const List<P> &list) : points_(list.Data()), count_(list.Count()) {}
+
+    //
+    // Public methods.
+    //
+    size_t Count() const {
+        return count_;
+    }
+
+    P* Data() const {
+        return points_;
+    }
+
+    // Returns a view over the points in [begin, end).
+    BasicFrame Slice(size_t begin, size_t end) const {
+        assert((begin <= end) && (end <= count_));
+        // --------------------------------
+        return BasicFrame(points_ + begin, end - begin);
+    }
+
+    void CopyFrom(const BasicFrame &other) {
+        assert(other.count_ == count_);
+        // --------------------------------
+        std::copy(other.points_, other.points_ + count_, points_);
+    }
+
+    P &operator [](size_t index) const {
+        assert(index < count_);
+        // --------------------------------
+        return points_[index];
+    }
+};
+
+typedef BasicFrame<Point> Frame;
+typedef BasicFrame<PointF> FrameF;
+
+
+// Stores the frames generated by a storyboard in a single contiguous slab.
+// The slab is sized once for the whole animation and reused between
+// plays, so adding a frame during playback never touches the heap.
+// FrameStoreF holds the frames of the float32 pipeline.
+template <class P>
+class BasicFrameStore {
+private:
+    P* slab_;
+    size_t capacity_;   // Number of points the slab can hold.
+    size_t pointCount_; // Number of points in each frame.
+    size_t frameCount_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    BasicFrameStore() : slab_(NULL), capacity_(0), pointCount_(0), frameCount_(0) {}
+
+    ~BasicFrameStore() {
+        delete[] slab_;
+    }
+
+    //
+    // Public methods.
+    //
+    // Removes all frames and prepares the store for 'frames' frames
+    // having 'points' points each. The slab is reallocated only if
+    // it's too small to hold all of them.
+    void Reserve(size_t frames, size_t points) {
+        frameCount_ = 0;
+        pointCount_ = points;
+
+        if(frames * points > capacity_) {
+            delete[] slab_;
+            capacity_ = frames * points;
+            slab_ = new P[capacity_];
+        }
+    }
+
+    // Appends a frame and returns a view over its points.
+    // The contents of the frame are not initialized.
+    BasicFrame<P> AddFrame() {
+        EnsureSpace(frameCount_ + 1);
+        frameCount_++;
+        return (*this)[frameCount_ - 1];
+    }
+
+    void Clear() {
+        frameCount_ = 0;
+    }
+
+    // Removes the frames after the first 'count' ones.
+    void Truncate(size_t count) {
+        frameCount_ = std::min(frameCount_, count);
+    }
+
+    size_t Count() const {
+        return frameCount_;
+    }
+
+    size_t PointCount() const {
+        return pointCount_;
+    }
+
+    size_t FrameCapacity() const {
+        return pointCount_ == 0 ? 0 : capacity_ / pointCount_;
+    }
+
+    BasicFrame<P> operator [](size_t index) const {
+        assert(index < frameCount_);
+        // --------------------------------
+        return BasicFrame<P>(&slab_[index * pointCount_], pointCount_);
+    }
+
+private:
+    BasicFrameStore(const BasicFrameStore &other);
+    BasicFrameStore &operator =(const BasicFrameStore &other);
+
+    void EnsureSpace(size_t newCount) {
+        // Only happens if more frames are added than were reserved.
+        // All frames obtained before are invalidated.
+        if(newCount * pointCount_ > capacity_) {
+            P* oldSlab = slab_;
+            size_t newCapacity = std::max(capacity_ * 2, newCount * pointCount_);
+            slab_ = new P[newCapacity];
+
+            std::copy(oldSlab, oldSlab + frameCount_ * pointCount_, slab_);
+            capacity_ = newCapacity;
+            delete[] oldSlab;
+        }
+    }
+};
+
+typedef BasicFrameStore<Point> FrameStore;
+typedef BasicFrameStore<PointF> FrameStoreF;
+
+#endif
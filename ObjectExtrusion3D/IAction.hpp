@@ -34,6 +34,9 @@
 #define I_ACTION_HPP
 
 #include "Point.hpp"
+#include "FrameStore.hpp"
+#include "Transform.hpp"
+#include "PointBuffer.hpp"
 #include "ISerializable.hpp"
 
 enum ActionType {
@@ -50,11 +53,49 @@ protected:
 
 public:
     IAction() : withPrevious_(false), steps_(0) {}
-    ~IAction() {}
+    virtual ~IAction() {}
 
     virtual ActionType Type() = 0;
-    virtual void Initialize(const List<Point> &points) {}
-    virtual void Execute(int step, List<Point> &points) = 0;
+    virtual void Initialize(const Frame &points) {}
+    // Returns the affine transform the given step applies to the points.
+    // 'points' are the points before the step; they are read only by
+    // actions whose transform depends on the shape (see NeedsPoints).
+    virtual Transform StepTransform(int step, const Frame &points) = 0;
+
+    // Executes the step on the points. With a thread pool, the points
+    // of large shapes are transformed in chunks, in parallel.
+    virtual void Execute(int step, Frame &points, ThreadPool *pool = NULL) {
+        Transform transform = StepTransform(step, points);
+        transform.Apply(points, points, pool);
+        PointsTransformed(transform);
+    }
+
+    // The buffer is transformed by the SIMD kernel. The points are converted
+    // only if the transform depends on them, otherwise nothing is allocated.
+    virtual void Execute(int step, PointBuffer &points) {
+        Transform transform;
+
+        if(NeedsPoints()) {
+            List<Point> current;
+            points.CopyTo(current);
+            transform = StepTransform(step, current);
+        }
+        else {
+            transform = StepTransform(step, Frame());
+        }
+
+        points.Apply(transform);
+        PointsTransformed(transform);
+    }
+
+    virtual bool NeedsPoints() {
+        return false;
+    }
+
+    // Called after a step of this action, or of an action linked with it,
+    // transformed the points. Allows actions to track the state of the points
+    // instead of examining them at each step.
+    virtual void PointsTransformed(const Transform &transform) {}
     
     bool WithPrevious() { 
         return withPrevious_; 
@@ -36,14 +36,24 @@
 #include "ISerializable.hpp"
 #include "Stream.hpp"
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <algorithm>
+#include <utility>
+#include <type_traits>
 
+// A growable array. Trivial items (like int or pointers) are copied and moved
+// with memcpy/memmove; the others (like Point, which has a vtable) are
+// assigned one by one. A list can be moved, which transfers its array.
+// std::is_trivial is used because the Visual C++ 2012 library
+// doesn't have std::is_trivially_copyable.
 template <class T>
 class List : public ISerializable {
 private:
     static const size_t DEFAULT_CAPACITY;
 
+    typedef std::integral_constant<bool, std::is_trivial<T>::value> IsTrivial;
+
     T* array_;
     size_t count_;
     size_t capacity_;
@@ -59,15 +69,23 @@ public:
                             capacity_(capacity) {}
     
     List(T* items, size_t count) : array_(new T[count]), count_(count), capacity_(count) {
-        assert(items != null);
+        assert((count == 0) || (items != NULL));
         // --------------------------------
-        memcpy(array_, items, count * sizeof(T));
+        CopyItems(array_, items, count, IsTrivial());
     }
     
     List(const List &other) : array_(new T[other.count_]),
                               count_(other.count_), 
                               capacity_(other.count_) {
-        memcpy(array_, other.array_, count_ * sizeof(T));
+        CopyItems(array_, other.array_, count_, IsTrivial());
+    }
+
+    // Takes the array of the other list, which is left empty.
+    List(List &&other) : array_(other.array_), count_(other.count_),
+                         capacity_(other.capacity_) {
+        other.array_ = NULL;
+        other.count_ = 0;
+        other.capacity_ = 0;
     }
     
     ~List() {
@@ -82,11 +100,16 @@ public:
         array_[count_++] = item;
     }
     
+    // A moved-from list has no array, but it has no items either.
     void Add(T* items, int count) {
-        assert(items != NULL);
+        assert((count == 0) || (items != NULL));
         // --------------------------------
+        if(count == 0) {
+            return;
+        }
+
         EnsureSpace(count_ + count);
-        memcpy(&array_[count_], items, count * sizeof(T));
+        CopyItems(&array_[count_], items, count, IsTrivial());
         count_ += count;
     }
     
@@ -115,6 +138,25 @@ public:
     size_t Count() const { 
         return count_; 
     }
+
+    T* Data() const {
+        return array_;
+    }
+
+    // Makes room for at least 'capacity' items, so that adding them
+    // doesn't need to grow the array again.
+    void Reserve(size_t capacity) {
+        if(capacity > capacity_) {
+            Reallocate(capacity);
+        }
+    }
+
+    // Exchanges the items of the lists without copying them.
+    void Swap(List &other) {
+        std::swap(array_, other.array_);
+        std::swap(count_, other.count_);
+        std::swap(capacity_, other.capacity_);
+    }
     
     void Insert(const T &item, size_t index) {
         assert(index <= count_);
@@ -126,7 +168,7 @@ public:
             array_[count_++] = item;
         }
         else {
-            memmove(&array_[index + 1], &array_[index], (count_ - index) * sizeof(T));
+            ShiftItems(&array_[index + 1], &array_[index], count_ - index, IsTrivial());
             array_[index] = item;
             count_++;
         }
@@ -139,11 +181,18 @@ public:
             count_--;
         }
         else {
-            memmove(&array_[index], &array_[index + 1], (count_ - index) * sizeof(T));
+            ShiftItems(&array_[index], &array_[index + 1], count_ - index - 1, IsTrivial());
             count_--;
         }
     }
     
+    // Removes the items after the first 'count' ones.
+    void Truncate(size_t count) {
+        if(count < count_) {
+            count_ = count;
+        }
+    }
+
     void Remove(const T &item) {
         for(size_t i = 0; i < count_; i++) {
             if(array_[i] == item) {
@@ -159,15 +208,19 @@ public:
     virtual void Serialize(Stream &stream) const {
         // First write the number of elements, then each element in turn.
         stream.Write(count_);
-
-        for(size_t i = 0; i < count_; i++) {
-            stream.Write(array_[i]);
-        }
+        stream.WriteArray(array_, count_);
     }
 
     virtual void Deserialize(Stream &stream) {
         delete[] array_;
         stream.Read(count_);
+
+        // Each item takes at least a byte, so a larger count
+        // means the data is not valid.
+        if(count_ > stream.Remaining()) {
+            stream.SetFailed();
+            count_ = 0;
+        }
         
         if(count_ == 0) {
             array_ = new T[DEFAULT_CAPACITY];
@@ -176,10 +229,7 @@ public:
         else {
             array_ = new T[count_];
             capacity_ = count_;
-
-            for(size_t i = 0; i < count_; i++) {
-                stream.Read(array_[i]);
-            }
+            stream.ReadArray(array_, count_);
         }
     }
     
@@ -189,28 +239,81 @@ public:
         return array_[index];
     }
     
-    List operator =(const List &other) {
+    List &operator =(const List &other) {
         if(&other == this) {
             return *this;
         }
         
         T* newArray = new T[other.count_];
-        std::copy(other.array_, other.array_ + other.count_, other.count_);
+        CopyItems(newArray, other.array_, other.count_, IsTrivial());
         
         count_ = other.count_;
         capacity_ = other.count_;
         delete[] array_;
-        array_ = newArray_;
+        array_ = newArray;
+        return *this;
+    }
+
+    List &operator =(List &&other) {
+        if(&other != this) {
+            delete[] array_;
+            array_ = other.array_;
+            count_ = other.count_;
+            capacity_ = other.capacity_;
+            other.array_ = NULL;
+            other.count_ = 0;
+            other.capacity_ = 0;
+        }
+
         return *this;
     }
     
 private:
     void EnsureSpace(size_t newCount) {
         if(newCount > capacity_) {
-            T* oldArray = array_;
-            array_ = new T[capacity_ * 2];
-            memcpy(array_, oldArray, count_ * sizeof(T));
-            capacity_ *= 2;
+            Reallocate(std::max(capacity_ * 2, newCount));
+        }
+    }
+
+    void Reallocate(size_t newCapacity) {
+        T* oldArray = array_;
+        array_ = new T[newCapacity];
+        MoveItems(array_, oldArray, count_, IsTrivial());
+        capacity_ = newCapacity;
+        delete[] oldArray;
+    }
+
+    // Copies items to a location which doesn't overlap them.
+    static void CopyItems(T *dest, const T *source, size_t count, std::true_type) {
+        if(count > 0) {
+            memcpy(dest, source, count * sizeof(T));
+        }
+    }
+
+    static void CopyItems(T *dest, const T *source, size_t count, std::false_type) {
+        std::copy(source, source + count, dest);
+    }
+
+    // Moves items to a location which doesn't overlap them.
+    static void MoveItems(T *dest, T *source, size_t count, std::true_type) {
+        CopyItems(dest, source, count, std::true_type());
+    }
+
+    static void MoveItems(T *dest, T *source, size_t count, std::false_type) {
+        std::move(source, source + count, dest);
+    }
+
+    // Moves items inside the array; the ranges can overlap.
+    static void ShiftItems(T *dest, T *source, size_t count, std::true_type) {
+        memmove(dest, source, count * sizeof(T));
+    }
+
+    static void ShiftItems(T *dest, T *source, size_t count, std::false_type) {
+        if(dest < source) {
+            std::move(source, source + count, dest);
+        }
+        else {
+            std::move_backward(source, source + count, dest + count);
         }
     }
 };
@@ -0,0 +1,355 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MESH_BUILDER_HPP
+#define MESH_BUILDER_HPP
+
+#include "Point.hpp"
+#include "List.hpp"
+#include "FrameStore.hpp"
+#include <cmath>
+#include <cassert>
+
+// An indexed triangle mesh. Each vertex has a normal,
+// and each triangle is given by three vertex indices.
+// The vertices can be Point (Mesh) or PointF (MeshF).
+template <class P>
+class BasicMesh {
+private:
+    List<P> vertices_;
+    List<P> normals_;
+    List<size_t> indices_;
+
+public:
+    //
+    // Constructors.
+    //
+    BasicMesh() {}
+
+    //
+    // Public methods.
+    //
+    List<P>& Vertices() {
+        return vertices_;
+    }
+
+    List<P>& Normals() {
+        return normals_;
+    }
+
+    List<size_t>& Indices() {
+        return indices_;
+    }
+
+    size_t VertexCount() const {
+        return vertices_.Count();
+    }
+
+    size_t TriangleCount() const {
+        return indices_.Count() / 3;
+    }
+
+    void Clear() {
+        vertices_.Clear();
+        normals_.Clear();
+        indices_.Clear();
+    }
+
+private:
+    BasicMesh(const BasicMesh &other);
+    BasicMesh &operator =(const BasicMesh &other);
+};
+
+typedef BasicMesh<Point> Mesh;
+typedef BasicMesh<PointF> MeshF;
+
+
+// Builds the surface swept by the shape as an indexed triangle mesh.
+// The points of each frame become vertices (frame i, point j is vertex
+// i * PointCount + j) and each pair of consecutive frames is connected
+// by a strip of triangles. Frames are appended as they are generated,
+// so the mesh is never built again from the start.
+// The normal of a vertex is the average of the normals of the triangles
+// around it, weighted by their area. The sums for each strip are cached,
+// so a new or changed frame needs only its two strips to be computed.
+// MeshBuilderF builds a float mesh, from float or double frames.
+template <class P>
+class BasicMeshBuilder {
+private:
+    typedef typename P::Scalar Scalar;
+
+    BasicMesh<P> mesh_;
+    size_t pointCount_;
+    size_t frameCount_;
+    // For each strip, the sum of the triangle normals at its vertices,
+    // first for the points of the previous frame, then of its own frame.
+    List<P> stripNormals_;
+
+public:
+    //
+    // Constructors.
+    //
+    BasicMeshBuilder() : pointCount_(0), frameCount_(0) {}
+
+    //
+    // Public methods.
+    //
+    BasicMesh<P>& MeshObject() {
+        return mesh_;
+    }
+
+    size_t FrameCount() const {
+        return frameCount_;
+    }
+
+    size_t PointCount() const {
+        return pointCount_;
+    }
+
+    void Clear() {
+        mesh_.Clear();
+        stripNormals_.Clear();
+        pointCount_ = 0;
+        frameCount_ = 0;
+    }
+
+    // Appends the frames of the store which were not added yet.
+    // If the store has fewer frames than the mesh (the storyboard was 
+    // played again), the mesh is built again.
+    template <class Q>
+    void Update(const BasicFrameStore<Q> &frames) {
+        if((frames.Count() < frameCount_) || 
+           ((frameCount_ > 0) && (frames.PointCount() != pointCount_))) {
+            Clear();
+        }
+
+        // When several frames are added at once, the lists are sized for
+        // all of them, instead of growing as each frame is added.
+        if(frames.Count() > frameCount_ + 1) {
+            Reserve(frames.Count(), frames.PointCount());
+        }
+
+        for(size_t i = frameCount_; i < frames.Count(); i++) {
+            AddFrame(frames[i]);
+        }
+    }
+
+    // Appends the frame, connecting it with the previous one.
+    template <class Q>
+    void AddFrame(const BasicFrame<Q> &frame) {
+        assert((frameCount_ == 0) || (frame.Count() == pointCount_));
+        // --------------------------------
+        pointCount_ = frame.Count();
+
+        for(size_t i = 0; i < frame.Count(); i++) {
+            mesh_.Vertices().Add(Convert(frame[i]));
+            mesh_.Normals().Add(P());
+        }
+
+        frameCount_++;
+
+        if(frameCount_ > 1) {
+            AddStrip(frameCount_ - 1);
+            UpdateNormals(frameCount_ - 2);
+        }
+
+        UpdateNormals(frameCount_ - 1);
+    }
+
+    // Replaces the points of a frame. Only the two strips
+    // connected to the frame and the normals they affect are computed again.
+    template <class Q>
+    void FrameChanged(size_t index, const BasicFrame<Q> &frame) {
+        assert(index < frameCount_);
+        assert(frame.Count() == pointCount_);
+        // --------------------------------
+        for(size_t i = 0; i < frame.Count(); i++) {
+            mesh_.Vertices()[index * pointCount_ + i] = Convert(frame[i]);
+        }
+
+        if(index > 0) {
+            ComputeStripNormals(index);
+            UpdateNormals(index - 1);
+        }
+
+        if(index + 1 < frameCount_) {
+            ComputeStripNormals(index + 1);
+            UpdateNormals(index + 1);
+        }
+
+        UpdateNormals(index);
+    }
+
+    // Removes the frames starting with 'first' and their triangles,
+    // for example after they were changed by editing an action.
+    void RemoveFrames(size_t first) {
+        if(first >= frameCount_) return;
+
+        frameCount_ = first;
+        mesh_.Vertices().Truncate(first * pointCount_);
+        mesh_.Normals().Truncate(first * pointCount_);
+        mesh_.Indices().Truncate(StripIndex(first));
+        stripNormals_.Truncate(first == 0 ? 0 : (first - 1) * 2 * pointCount_);
+
+        if(first > 0) {
+            UpdateNormals(first - 1);
+        }
+    }
+
+private:
+    // Returns the position of the first index of the strip
+    // connecting the given frame with the previous one.
+    size_t StripIndex(size_t frame) const {
+        return frame == 0 ? 0 : (frame - 1) * (pointCount_ - 1) * 6;
+    }
+
+    void Reserve(size_t frameCount, size_t pointCount) {
+        size_t strips = frameCount - 1;
+        size_t quads = pointCount > 0 ? pointCount - 1 : 0;
+
+        mesh_.Vertices().Reserve(frameCount * pointCount);
+        mesh_.Normals().Reserve(frameCount * pointCount);
+        mesh_.Indices().Reserve(strips * quads * 6);
+        stripNormals_.Reserve(strips * 2 * pointCount);
+    }
+
+    template <class Q>
+    static P Convert(const Q &point) {
+        return P((Scalar)point.X, (Scalar)point.Y, (Scalar)point.Z);
+    }
+
+    void AddStrip(size_t frame) {
+        List<size_t> &indices = mesh_.Indices();
+        size_t a = (frame - 1) * pointCount_;
+        size_t b = frame * pointCount_;
+
+        // Each quad between the frames is split in two triangles.
+        for(size_t i = 0; i + 1 < pointCount_; i++) {
+            indices.Add(a + i);
+            indices.Add(b + i + 1);
+            indices.Add(b + i);
+            indices.Add(a + i);
+            indices.Add(a + i + 1);
+            indices.Add(b + i + 1);
+        }
+
+        for(size_t i = 0; i < 2 * pointCount_; i++) {
+            stripNormals_.Add(P());
+        }
+
+        ComputeStripNormals(frame);
+    }
+
+    // Sums the normals of the triangles of the strip connecting
+    // the given frame with the previous one at each of their vertices.
+    void ComputeStripNormals(size_t frame) {
+        if(pointCount_ == 0) return;
+
+        List<P> &vertices = mesh_.Vertices();
+        P *lower = &stripNormals_[(frame - 1) * 2 * pointCount_];
+        P *upper = lower + pointCount_;
+        const P *a = &vertices[(frame - 1) * pointCount_];
+        const P *b = &vertices[frame * pointCount_];
+
+        for(size_t i = 0; i < pointCount_; i++) {
+            lower[i] = P();
+            upper[i] = P();
+        }
+
+        for(size_t i = 0; i + 1 < pointCount_; i++) {
+            // The length of the cross product is twice the area of the triangle.
+            P first = TriangleNormal(a[i], b[i + 1], b[i]);
+            P second = TriangleNormal(a[i], a[i + 1], b[i + 1]);
+
+            AddTo(lower[i], first);
+            AddTo(upper[i + 1], first);
+            AddTo(upper[i], first);
+            AddTo(lower[i], second);
+            AddTo(lower[i + 1], second);
+            AddTo(upper[i + 1], second);
+        }
+    }
+
+    // Computes the normals of the frame from the strips before and after it.
+    void UpdateNormals(size_t frame) {
+        if(pointCount_ == 0) return;
+
+        P *normals = &mesh_.Normals()[0] + frame * pointCount_;
+
+        for(size_t i = 0; i < pointCount_; i++) {
+            P sum;
+
+            if(frame > 0) {
+                AddTo(sum, stripNormals_[(frame - 1) * 2 * pointCount_ + pointCount_ + i]);
+            }
+
+            if(frame + 1 < frameCount_) {
+                AddTo(sum, stripNormals_[frame * 2 * pointCount_ + i]);
+            }
+
+            Scalar magnitude = sqrt(sum.X * sum.X + sum.Y * sum.Y + sum.Z * sum.Z);
+
+            if(magnitude > 0) {
+                sum.X /= magnitude;
+                sum.Y /= magnitude;
+                sum.Z /= magnitude;
+            }
+
+            normals[i] = sum;
+        }
+    }
+
+    // Returns the cross product of the edges starting at 'a'.
+    static P TriangleNormal(const P &a, const P &b, const P &c) {
+        Scalar px = b.X - a.X;
+        Scalar py = b.Y - a.Y;
+        Scalar pz = b.Z - a.Z;
+        Scalar qx = c.X - a.X;
+        Scalar qy = c.Y - a.Y;
+        Scalar qz = c.Z - a.Z;
+
+        return P(py * qz - pz * qy,
+                 pz * qx - px * qz,
+                 px * qy - py * qx);
+    }
+
+    static void AddTo(P &sum, const P &value) {
+        sum.X += value.X;
+        sum.Y += value.Y;
+        sum.Z += value.Z;
+    }
+};
+
+typedef BasicMeshBuilder<Point> MeshBuilder;
+typedef BasicMeshBuilder<PointF> MeshBuilderF;
+
+#endif
@@ -0,0 +1,384 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MESH_EXPORTER_HPP
+#define MESH_EXPORTER_HPP
+
+#include "Point.hpp"
+#include "List.hpp"
+#include "MeshBuilder.hpp"
+#include "Stream.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+// Collects small writes in a large buffer, so that the stream
+// is written in a few large blocks instead of a call per value.
+class WriteBuffer {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    Stream *stream_;
+    char *buffer_;
+    size_t count_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    WriteBuffer(Stream &stream) : stream_(&stream), count_(0) {
+        buffer_ = new char[BUFFER_SIZE];
+    }
+
+    ~WriteBuffer() {
+        Flush();
+        delete[] buffer_;
+    }
+
+    //
+    // Public methods.
+    //
+    void Write(const void *data, size_t size) {
+        if(count_ + size > BUFFER_SIZE) {
+            Flush();
+
+            // Blocks which don't fit are written directly.
+            if(size > BUFFER_SIZE) {
+                stream_->WriteBlock(data, size);
+                return;
+            }
+        }
+
+        memcpy(buffer_ + count_, data, size);
+        count_ += size;
+    }
+
+    template <class T>
+    void WriteValue(T value) {
+        Write(&value, sizeof(T));
+    }
+
+    void WriteText(const char *text) {
+        Write(text, strlen(text));
+    }
+
+    void Flush() {
+        if(count_ > 0) {
+            stream_->WriteBlock(buffer_, count_);
+            count_ = 0;
+        }
+    }
+
+private:
+    WriteBuffer(const WriteBuffer &other);
+    WriteBuffer &operator =(const WriteBuffer &other);
+};
+
+
+// Assigns the same index to vertices whose values are the same after
+// being rounded to a multiple of the tolerance (so points which differ only
+// by floating-point noise, like the ends of a closed circle, are welded).
+// Each vertex is made of up to six values (a position and a normal).
+class VertexIndex {
+private:
+    struct Key {
+        long long values[6];
+
+        bool operator ==(const Key &other) const {
+            return memcmp(values, other.values, sizeof(values)) == 0;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator ()(const Key &key) const {
+            // FNV-1a over the bytes of the values.
+            const unsigned char *bytes = (const unsigned char *)key.values;
+            size_t hash = 2166136261u;
+
+            for(size_t i = 0; i < sizeof(key.values); i++) {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+
+            return hash;
+        }
+    };
+
+    std::unordered_map<Key, size_t, KeyHash> indices_;
+    List<size_t> unique_; // The first vertex having each index.
+    double positionScale_;
+    double normalScale_;
+
+public:
+    VertexIndex(double positionTolerance, double normalTolerance) :
+            positionScale_(1.0 / positionTolerance), 
+            normalScale_(1.0 / normalTolerance) {
+        assert(positionTolerance > 0);
+        assert(normalTolerance > 0);
+    }
+
+    // Returns the index of the vertex made of the given values,
+    // adding it if it wasn't seen before.
+    template <class P>
+    size_t Add(const P &position, const P *normal, size_t vertex) {
+        Key key;
+        SetValues(key.values, position, positionScale_);
+
+        if(normal != NULL) {
+            SetValues(key.values + 3, *normal, normalScale_);
+        }
+        else {
+            key.values[3] = key.values[4] = key.values[5] = 0;
+        }
+
+        std::pair<std::unordered_map<Key, size_t, KeyHash>::iterator, bool> result =
+            indices_.insert(std::make_pair(key, unique_.Count()));
+
+        if(result.second) {
+            unique_.Add(vertex);
+        }
+
+        return result.first->second;
+    }
+
+    size_t Count() const {
+        return unique_.Count();
+    }
+
+    // Returns the first vertex which was assigned the given index.
+    size_t Vertex(size_t index) const {
+        return unique_[index];
+    }
+
+private:
+    template <class P>
+    static void SetValues(long long *values, const P &point, double scale) {
+        values[0] = (long long)floor(point.X * scale + 0.5);
+        values[1] = (long long)floor(point.Y * scale + 0.5);
+        values[2] = (long long)floor(point.Z * scale + 0.5);
+    }
+};
+
+
+// Returns the tolerance, relative to the magnitude of the values, used to weld
+// the vertices of a mesh having the given point type. For double it's well below
+// the precision of a float; for float it's a few times the rounding noise.
+template <class P>
+inline double RelativeTolerance() {
+    return std::max(1e-9, 64.0 * std::numeric_limits<typename P::Scalar>::epsilon());
+}
+
+// Returns the tolerance used to weld the vertices of a mesh:
+// a fraction of its largest coordinate.
+template <class P>
+inline double WeldTolerance(BasicMesh<P> &mesh) {
+    List<P> &vertices = mesh.Vertices();
+    double largest = 1.0;
+
+    for(size_t i = 0; i < mesh.VertexCount(); i++) {
+        largest = std::max(largest, (double)std::max(fabs(vertices[i].X),
+                                    std::max(fabs(vertices[i].Y), fabs(vertices[i].Z))));
+    }
+
+    return largest * RelativeTolerance<P>();
+}
+
+// Returns the tolerance used to weld (unit length) normals.
+template <class P>
+inline double NormalTolerance() {
+    return RelativeTolerance<P>();
+}
+
+
+// Writes a mesh as a Wavefront OBJ file. Positions and normals are
+// deduplicated separately and referenced by the faces ('f v//vn').
+class ObjExporter {
+private:
+    size_t vertexCount_;
+    size_t normalCount_;
+
+public:
+    ObjExporter() : vertexCount_(0), normalCount_(0) {}
+
+    // The number of positions and normals written by the last export.
+    size_t VertexCount() const {
+        return vertexCount_;
+    }
+
+    size_t NormalCount() const {
+        return normalCount_;
+    }
+
+    template <class P>
+    bool Save(BasicMesh<P> &mesh, wchar_t *path) {
+        Stream stream(path, true);
+        
+        if(!stream.IsValid()) {
+            return false;
+        }
+
+        Write(mesh, stream);
+        stream.Close();
+        return !stream.Failed();
+    }
+
+    template <class P>
+    void Write(BasicMesh<P> &mesh, Stream &stream) {
+        List<P> &vertices = mesh.Vertices();
+        List<P> &normals = mesh.Normals();
+        List<size_t> &indices = mesh.Indices();
+        VertexIndex positionIndex(WeldTolerance(mesh), NormalTolerance<P>());
+        VertexIndex normalIndex(NormalTolerance<P>(), NormalTolerance<P>());
+        List<size_t> positionMap;
+        List<size_t> normalMap;
+
+        for(size_t i = 0; i < mesh.VertexCount(); i++) {
+            positionMap.Add(positionIndex.Add(vertices[i], (const P *)NULL, i));
+            normalMap.Add(normalIndex.Add(normals[i], (const P *)NULL, i));
+        }
+
+        WriteBuffer buffer(stream);
+        char line[256];
+        buffer.WriteText("# Written by ObjectExtrusion3D\n");
+
+        for(size_t i = 0; i < positionIndex.Count(); i++) {
+            const P &point = vertices[positionIndex.Vertex(i)];
+            sprintf(line, "v %.9g %.9g %.9g\n", point.X, point.Y, point.Z);
+            buffer.WriteText(line);
+        }
+
+        for(size_t i = 0; i < normalIndex.Count(); i++) {
+            const P &normal = normals[normalIndex.Vertex(i)];
+            sprintf(line, "vn %.6g %.6g %.6g\n", normal.X, normal.Y, normal.Z);
+            buffer.WriteText(line);
+        }
+
+        // OBJ indices start with 1.
+        for(size_t i = 0; i + 2 < indices.Count(); i += 3) {
+            size_t a = indices[i];
+            size_t b = indices[i + 1];
+            size_t c = indices[i + 2];
+            sprintf(line, "f %u//%u %u//%u %u//%u\n", 
+                    (unsigned)positionMap[a] + 1, (unsigned)normalMap[a] + 1,
+                    (unsigned)positionMap[b] + 1, (unsigned)normalMap[b] + 1,
+                    (unsigned)positionMap[c] + 1, (unsigned)normalMap[c] + 1);
+            buffer.WriteText(line);
+        }
+
+        vertexCount_ = positionIndex.Count();
+        normalCount_ = normalIndex.Count();
+    }
+};
+
+
+// Writes a mesh as a binary (little endian) PLY file. Vertices with
+// the same position and normal are written once.
+class PlyExporter {
+private:
+    size_t vertexCount_;
+
+public:
+    PlyExporter() : vertexCount_(0) {}
+
+    // The number of vertices written by the last export.
+    size_t VertexCount() const {
+        return vertexCount_;
+    }
+
+    template <class P>
+    bool Save(BasicMesh<P> &mesh, wchar_t *path) {
+        Stream stream(path, true);
+        
+        if(!stream.IsValid()) {
+            return false;
+        }
+
+        Write(mesh, stream);
+        stream.Close();
+        return !stream.Failed();
+    }
+
+    template <class P>
+    void Write(BasicMesh<P> &mesh, Stream &stream) {
+        List<P> &vertices = mesh.Vertices();
+        List<P> &normals = mesh.Normals();
+        List<size_t> &indices = mesh.Indices();
+        VertexIndex vertexIndex(WeldTolerance(mesh), NormalTolerance<P>());
+        List<size_t> vertexMap;
+
+        for(size_t i = 0; i < mesh.VertexCount(); i++) {
+            vertexMap.Add(vertexIndex.Add(vertices[i], &normals[i], i));
+        }
+
+        WriteBuffer buffer(stream);
+        char header[512];
+        sprintf(header, "ply\n"
+                        "format binary_little_endian 1.0\n"
+                        "comment Written by ObjectExtrusion3D\n"
+                        "element vertex %u\n"
+                        "property float x\n"
+                        "property float y\n"
+                        "property float z\n"
+                        "property float nx\n"
+                        "property float ny\n"
+                        "property float nz\n"
+                        "element face %u\n"
+                        "property list uchar uint vertex_indices\n"
+                        "end_header\n",
+                (unsigned)vertexIndex.Count(), (unsigned)mesh.TriangleCount());
+        buffer.WriteText(header);
+
+        for(size_t i = 0; i < vertexIndex.Count(); i++) {
+            const P &point = vertices[vertexIndex.Vertex(i)];
+            const P &normal = normals[vertexIndex.Vertex(i)];
+            float values[6] = { (float)point.X,  (float)point.Y,  (float)point.Z,
+                                (float)normal.X, (float)normal.Y, (float)normal.Z };
+            buffer.Write(values, sizeof(values));
+        }
+
+        for(size_t i = 0; i + 2 < indices.Count(); i += 3) {
+            unsigned char count = 3;
+            unsigned int face[3] = { (unsigned int)vertexMap[indices[i]],
+                                     (unsigned int)vertexMap[indices[i + 1]],
+                                     (unsigned int)vertexMap[indices[i + 2]] };
+            buffer.WriteValue(count);
+            buffer.Write(face, sizeof(face));
+        }
+
+        vertexCount_ = vertexIndex.Count();
+    }
+};
+
+#endif
@@ -40,6 +40,7 @@
 
 class Point : public ISerializable {
 public:
+    typedef double Scalar;
     static const double EPSILON;
 
     double X;
@@ -68,7 +69,8 @@ public:
         return sqrt(X*X + Y*Y + Z*Z);
     }
 
-    static Point Centroid(const List<Point> &points) {
+    template <class TList>
+    static Point Centroid(const TList &points) {
         double sumX = 0;
         double sumY = 0;
         double sumZ = 0;
@@ -159,9 +161,84 @@ public:
         X /= value;
         Y /= value;
         Z /= value;
+        return *this;
     }
 };
 
 const double Point::EPSILON = 0.00001;
 
+// Arrays of points are written as blocks of coordinates,
+// in the same format as writing the points one by one.
+template <>
+struct Stream::ArrayHelper<Point> {
+    static const size_t POINTS_PER_BLOCK = 1024;
+
+    static void Write(const Point *items, size_t count, Stream &stream) {
+        double block[POINTS_PER_BLOCK * 3];
+
+        for(size_t first = 0; first < count; first += POINTS_PER_BLOCK) {
+            size_t points = count - first;
+            if(points > POINTS_PER_BLOCK) points = POINTS_PER_BLOCK;
+
+            for(size_t i = 0; i < points; i++) {
+                block[i * 3]     = items[first + i].X;
+                block[i * 3 + 1] = items[first + i].Y;
+                block[i * 3 + 2] = items[first + i].Z;
+            }
+
+            stream.WriteBlock(block, points * 3 * sizeof(double));
+        }
+    }
+
+    static void Read(Point *items, size_t count, Stream &stream) {
+        double block[POINTS_PER_BLOCK * 3];
+
+        for(size_t first = 0; first < count; first += POINTS_PER_BLOCK) {
+            size_t points = count - first;
+            if(points > POINTS_PER_BLOCK) points = POINTS_PER_BLOCK;
+            stream.ReadBlock(block, points * 3 * sizeof(double));
+
+            for(size_t i = 0; i < points; i++) {
+                items[first + i].X = block[i * 3];
+                items[first + i].Y = block[i * 3 + 1];
+                items[first + i].Z = block[i * 3 + 2];
+            }
+        }
+    }
+};
+
+
+
+// A point with float coordinates, used by the float32 pipeline
+// (FrameStoreF, MeshBuilderF). It has no virtual methods, 
+// so it takes 12 bytes instead of the 32 of Point.
+class PointF {
+public:
+    typedef float Scalar;
+
+    float X;
+    float Y;
+    float Z;
+
+    //
+    // Constructors.
+    //
+    PointF() : X(0), Y(0), Z(0) {}
+    PointF(float x, float y, float z) : X(x), Y(y), Z(z) {}
+
+    explicit PointF(const Point &point) : 
+            X((float)point.X), Y((float)point.Y), Z((float)point.Z) {}
+
+    //
+    // Public methods.
+    //
+    Point ToPoint() const {
+        return Point(X, Y, Z);
+    }
+};
+
+// The points are stored exactly as in memory.
+template <>
+struct Stream::ArrayHelper<PointF> : Stream::BlockArrayHelper<PointF> {};
+
 #endif
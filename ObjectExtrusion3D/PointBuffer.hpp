@@ -0,0 +1,264 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef POINT_BUFFER_HPP
+#define POINT_BUFFER_HPP
+
+#include "Point.hpp"
+#include "List.hpp"
+#include "FrameStore.hpp"
+#include "Transform.hpp"
+#include "TransformKernel.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <new>
+
+#if defined(_MSC_VER)
+    #include <malloc.h>
+#endif
+
+// Stores points as separate X, Y and Z arrays (structure of arrays).
+// Unlike List<Point>, the coordinates are packed and aligned, so they can
+// be copied with memcpy and processed by the SIMD transform kernel.
+// The coordinates can be stored as double (PointBuffer) or float (PointBufferF).
+template <class T>
+class BasicPointBuffer {
+private:
+    static const size_t ALIGNMENT = 32; // Enough for AVX.
+
+    T* x_;
+    T* y_;
+    T* z_;
+    size_t count_;
+    size_t capacity_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    BasicPointBuffer() : x_(NULL), y_(NULL), z_(NULL), count_(0), capacity_(0) {}
+
+    BasicPointBuffer(size_t capacity) : x_(NULL), y_(NULL), z_(NULL), 
+                                        count_(0), capacity_(0) {
+        Reserve(capacity);
+    }
+
+    BasicPointBuffer(const Frame &points) : x_(NULL), y_(NULL), z_(NULL), 
+                                            count_(0), capacity_(0) {
+        CopyFrom(points);
+    }
+
+    BasicPointBuffer(const FrameF &points) : x_(NULL), y_(NULL), z_(NULL), 
+                                             count_(0), capacity_(0) {
+        CopyFrom(points);
+    }
+
+    BasicPointBuffer(const BasicPointBuffer &other) : x_(NULL), y_(NULL), z_(NULL), 
+                                                      count_(0), capacity_(0) {
+        Resize(other.count_);
+        memcpy(x_, other.x_, count_ * sizeof(T));
+        memcpy(y_, other.y_, count_ * sizeof(T));
+        memcpy(z_, other.z_, count_ * sizeof(T));
+    }
+
+    ~BasicPointBuffer() {
+        AlignedFree(x_);
+    }
+
+    //
+    // Public methods.
+    //
+    size_t Count() const {
+        return count_;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    T* X() const {
+        return x_;
+    }
+
+    T* Y() const {
+        return y_;
+    }
+
+    T* Z() const {
+        return z_;
+    }
+
+    void Clear() {
+        count_ = 0;
+    }
+
+    // Makes room for at least 'capacity' points, keeping the existing ones.
+    void Reserve(size_t capacity) {
+        if(capacity <= capacity_) {
+            return;
+        }
+
+        // All three arrays are placed in a single block. Each one starts
+        // at an aligned address because the capacity is rounded up.
+        size_t perAlignment = ALIGNMENT / sizeof(T);
+        size_t newCapacity = (capacity + perAlignment - 1) & ~(perAlignment - 1);
+        T* block = (T*)AlignedAlloc(3 * newCapacity * sizeof(T));
+
+        if(count_ > 0) {
+            memcpy(block, x_, count_ * sizeof(T));
+            memcpy(block + newCapacity, y_, count_ * sizeof(T));
+            memcpy(block + 2 * newCapacity, z_, count_ * sizeof(T));
+        }
+
+        AlignedFree(x_);
+        x_ = block;
+        y_ = block + newCapacity;
+        z_ = block + 2 * newCapacity;
+        capacity_ = newCapacity;
+    }
+
+    // Changes the number of points. New points are not initialized.
+    void Resize(size_t count) {
+        Reserve(count);
+        count_ = count;
+    }
+
+    void Add(const Point &point) {
+        if(count_ == capacity_) {
+            Reserve(std::max(capacity_ * 2, (size_t)16));
+        }
+
+        Set(count_++, point);
+    }
+
+    Point Get(size_t index) const {
+        assert(index < count_);
+        // --------------------------------
+        return Point(x_[index], y_[index], z_[index]);
+    }
+
+    void Set(size_t index, const Point &point) {
+        assert(index < capacity_);
+        // --------------------------------
+        x_[index] = (T)point.X;
+        y_[index] = (T)point.Y;
+        z_[index] = (T)point.Z;
+    }
+
+    // Replaces the contents of the buffer with the given points.
+    // Accepts List<Point> too, through the implicit conversion to Frame.
+    void CopyFrom(const Frame &points) {
+        CopyFromImpl(points);
+    }
+
+    void CopyFrom(const FrameF &points) {
+        CopyFromImpl(points);
+    }
+
+    // Writes the points into a frame having the same number of points.
+    // The frame can hold Point or PointF.
+    template <class P>
+    void CopyTo(BasicFrame<P> &points) const {
+        typedef typename P::Scalar Scalar;
+        assert(points.Count() == count_);
+        // --------------------------------
+        for(size_t i = 0; i < count_; i++) {
+            P &point = points[i];
+            point.X = (Scalar)x_[i];
+            point.Y = (Scalar)y_[i];
+            point.Z = (Scalar)z_[i];
+        }
+    }
+
+    void CopyTo(List<Point> &points) const {
+        points.Clear();
+
+        for(size_t i = 0; i < count_; i++) {
+            points.Add(Point(x_[i], y_[i], z_[i]));
+        }
+    }
+
+    void Apply(const Transform &transform) {
+        TransformKernel::Apply(transform, x_, y_, z_, x_, y_, z_, count_);
+    }
+
+    // Writes the transformed points into 'dest', which is resized if needed.
+    void Apply(const Transform &transform, BasicPointBuffer &dest) const {
+        dest.Resize(count_);
+        TransformKernel::Apply(transform, x_, y_, z_, dest.x_, dest.y_, dest.z_, count_);
+    }
+
+private:
+    BasicPointBuffer &operator =(const BasicPointBuffer &other);
+
+    static void* AlignedAlloc(size_t size) {
+        void *memory;
+#if defined(_MSC_VER)
+        memory = _aligned_malloc(size, ALIGNMENT);
+#else
+        if(posix_memalign(&memory, ALIGNMENT, size) != 0) {
+            memory = NULL;
+        }
+#endif
+        if(memory == NULL) {
+            throw std::bad_alloc();
+        }
+
+        return memory;
+    }
+
+    static void AlignedFree(void *memory) {
+#if defined(_MSC_VER)
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+
+    template <class P>
+    void CopyFromImpl(const BasicFrame<P> &points) {
+        Resize(points.Count());
+
+        for(size_t i = 0; i < count_; i++) {
+            x_[i] = (T)points[i].X;
+            y_[i] = (T)points[i].Y;
+            z_[i] = (T)points[i].Z;
+        }
+    }
+};
+
+typedef BasicPointBuffer<double> PointBuffer;
+typedef BasicPointBuffer<float> PointBufferF;
+
+#endif
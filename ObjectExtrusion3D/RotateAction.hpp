@@ -36,6 +36,7 @@
 #include "IAction.hpp"
 #include "Point.hpp"
 #include "List.hpp"
+#include "FrameStore.hpp"
 #include "ISerializable.hpp"
 #include "Stream.hpp"
 
@@ -116,28 +117,26 @@ public:
         rotation_ = value;
     }
 
-    virtual void Initialize(const List<Point> &points) {
+    virtual void Initialize(const Frame &points) {
         SelectOrigin(points);
         step_ = rotation_ / (double)steps_;
     }
 
-    virtual void Execute(int step, List<Point> &points) {
-        for(size_t i = 0; i < points.Count(); i++) {
-            switch(axis_) {
-                case AXIS_X: {
-                    RotateX(points[i], originPoint_, step);
-                    break;
-                }
-                case AXIS_Y: {
-                    RotateY(points[i], originPoint_, step);
-                    break;
-                }
-                case AXIS_Z: {
-                    RotateZ(points[i], originPoint_, step);
-                    break;
-                }
+    virtual Transform StepTransform(int step, const Frame &points) {
+        switch(axis_) {
+            case AXIS_X: {
+                return Transform::RotationX(step_, originPoint_);
+            }
+            case AXIS_Y: {
+                return Transform::RotationY(step_, originPoint_);
+            }
+            case AXIS_Z: {
+                return Transform::RotationZ(step_, originPoint_);
             }
         }
+
+        assert(false && "Unknown axis!");
+        return Transform();
     }
 
     //
@@ -165,7 +164,7 @@ public:
     }
     
 private:
-    Point& Left(const List<Point> &points) {
+    Point& Left(const Frame &points) {
         double left = std::numeric_limits<double>::max();
         int pos = 0;
         
@@ -179,7 +178,7 @@ private:
         return points[pos];
     }
 
-    Point& Right(const List<Point> &points) {
+    Point& Right(const Frame &points) {
         double right = -std::numeric_limits<double>::max();
         int pos = 0;
 
@@ -193,7 +192,7 @@ private:
         return points[pos];
     }
 
-    Point& Top(const List<Point> &points) {
+    Point& Top(const Frame &points) {
         double top = -std::numeric_limits<double>::max();
         int pos = 0;
 
@@ -207,7 +206,7 @@ private:
         return points[pos];
     }
 
-    Point& Bottom(const List<Point> &points) {
+    Point& Bottom(const Frame &points) {
         double bottom = std::numeric_limits<double>::max();
         int pos = 0;
         
@@ -221,7 +220,7 @@ private:
         return points[pos];
     }
 
-    Point& Front(const List<Point> &points) {
+    Point& Front(const Frame &points) {
         double front = -std::numeric_limits<double>::max();
         int pos = 0;
         
@@ -235,7 +234,7 @@ private:
         return points[pos];
     }
 
-    Point& Back(const List<Point> &points) {
+    Point& Back(const Frame &points) {
         double back = std::numeric_limits<double>::max();
         int pos = 0;
         
@@ -249,7 +248,7 @@ private:
         return points[pos];
     }
 
-    void SelectOrigin(const List<Point> &points) {
+    void SelectOrigin(const Frame &points) {
         switch(origin_) {
             case ROTATION_CENTER: {
                 originPoint_ = Point::Centroid(points);
@@ -280,39 +279,6 @@ private:
             }
         }
     }
-
-    void RotateX(Point &point, const Point &origin, int step) {
-        double y = point.Y - origin.Y;
-        double z = point.Z - origin.Z;
-        
-        point.Y = y * cos(step_) - z * sin(step_);
-        point.Z = y * sin(step_) + z * cos(step_);
-
-        point.Y += origin.Y;
-        point.Z += origin.Z;
-    }
-
-    void RotateY(Point &point, const Point &origin, int step) {
-        double x = point.X - origin.X;
-        double z = point.Z - origin.Z;
-        
-        point.X = z * sin(step_) + x * cos(step_);
-        point.Z = z * cos(step_) - x * sin(step_);
-
-        point.X += origin.X;
-        point.Z += origin.Z;
-    }
-     
-    void RotateZ(Point &point, const Point &origin, int step) {
-        double x = point.X - origin.X;
-        double y = point.Y - origin.Y;
-        
-        point.X = x * cos(step_) - y * sin(step_);
-        point.Y = x * sin(step_) + y * cos(step_);
-
-        point.X += origin.X;
-        point.Y += origin.Y;
-    }
 };
 
 #endif
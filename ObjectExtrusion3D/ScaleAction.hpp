@@ -37,12 +37,14 @@
 #include "IAction.hpp"
 #include "Point.hpp"
 #include "List.hpp"
+#include "FrameStore.hpp"
 #include "ISerializable.hpp"
 #include "Stream.hpp"
 #include <math.h>
 #undef max
 #undef min
 #include <limits>
+#include <algorithm>
 
 class ScaleAction: public IAction {
 private:
@@ -52,7 +54,9 @@ private:
     double stepX_;
     double stepY_;
     double stepZ_;
-    Point centroid_; // Shape center point.
+    Point centroid_;       // Center of the points the action was initialized with.
+    double minDistance_;   // Their smallest distance from the center.
+    Transform transform_;  // Applied to the points since then.
 
 public:
     //
@@ -94,37 +98,41 @@ public:
         scaleZ_ = value;
     }
 
-    virtual void Initialize(const List<Point> &points) {
+    virtual void Initialize(const Frame &points) {
         stepX_ = scaleX_ / (double)steps_;
         stepY_ = scaleY_ / (double)steps_;
         stepZ_ = scaleZ_ / (double)steps_;
-    }
 
-    virtual void Execute(int step, List<Point> &points) {
         centroid_ = Point::Centroid(points);
-        double minDistance = std::numeric_limits<double>::max();
+        minDistance_ = MinDistance(points, centroid_);
+        transform_ = Transform::Identity();
+    }
 
-        for(size_t i = 0; i < points.Count(); i++) {
-            double distance = points[i].Distance(centroid_);
-            if(distance < minDistance) {
-                minDistance = distance;
-            }
-        }
+    // Moving each point away from the centroid along its direction by
+    // 'step * distance / minDistance' is the same as scaling each axis
+    // around the centroid by '1 + step / minDistance'.
+    // An affine transform maps the centroid to the centroid of the transformed 
+    // points, and as long as all distances changed by the same factor the
+    // minimum distance is known too, so the points need to be examined
+    // only after a non-uniform scale.
+    virtual Transform StepTransform(int step, const Frame &points) {
+        Point centroid = transform_.Apply(centroid_);
+        double scale;
+        double minDistance = transform_.IsSimilarity(scale) ? 
+                             minDistance_ * scale : MinDistance(points, centroid);
+
+        return Transform::Scaling(1 + stepX_ / minDistance,
+                                  1 + stepY_ / minDistance,
+                                  1 + stepZ_ / minDistance, centroid);
+    }
 
-        for(size_t i = 0; i < points.Count(); i++) {
-            Point &point = points[i];
-            double distance = point.Distance(centroid_);
-
-            // Compute the angle between the point and the center on each axis.
-            double angle1 = atan2(point.Y - centroid_.Y,
-                                  point.X - centroid_.X);
-            double angle2 = acos((point.Z - centroid_.Z) / distance);
-            double scale = distance / minDistance;
-
-            point.X = centroid_.X + ((distance + stepX_ * scale) * cos(angle1) * sin(angle2));
-            point.Y = centroid_.Y + ((distance + stepY_ * scale) * sin(angle1) * sin(angle2));
-            point.Z = centroid_.Z + ((distance + stepZ_ * scale) * cos(angle2));
-        }
+    virtual bool NeedsPoints() {
+        double scale;
+        return !transform_.IsSimilarity(scale);
+    }
+
+    virtual void PointsTransformed(const Transform &transform) {
+        transform_ = transform * transform_;
     }
 
     //
@@ -145,6 +153,20 @@ public:
         stream.Read(scaleY_);
         stream.Read(scaleZ_);
     }
+
+private:
+    static double MinDistance(const Frame &points, const Point &centroid) {
+        double minDistance = std::numeric_limits<double>::max();
+
+        for(size_t i = 0; i < points.Count(); i++) {
+            double dx = points[i].X - centroid.X;
+            double dy = points[i].Y - centroid.Y;
+            double dz = points[i].Z - centroid.Z;
+            minDistance = std::min(minDistance, dx * dx + dy * dy + dz * dz);
+        }
+
+        return sqrt(minDistance);
+    }
 };
 
 #endif
@@ -38,6 +38,8 @@
 #include "BezierShape.hpp"
 #include "ISerializable.hpp"
 #include "Stream.hpp"
+#include "SceneContainer.hpp"
+#include "FrameCache.hpp"
 #include <cstdlib>
 
 enum SceneState {
@@ -46,10 +48,17 @@ enum SceneState {
     SCENE_END
 };
 
+// The sections of a scene file (four character codes).
+enum SceneSection {
+    SECTION_SHAPE      = 0x50414853, // "SHAP"
+    SECTION_STORYBOARD = 0x59525453, // "STRY"
+    SECTION_FRAMES     = 0x534D5246  // "FRMS", optional
+};
+
 class Scene : public ISerializable {
 private:
     Shape *shape_;
-    Storyboard storyBoard_;
+    ::Storyboard storyBoard_;
     SceneState state_;
 
 public:
@@ -80,10 +89,25 @@ public:
         storyBoard_.SetShapeObject(shape);
     }
 
-    Storyboard& Storyboard() {
+    ::Storyboard& Storyboard() {
         return storyBoard_;
     }
 
+    // Changes the tolerance used to tessellate a Bezier shape (see
+    // BezierShape::SetTolerance). The frames already generated or restored
+    // from the file are removed. Returns false if the shape is not a Bezier one.
+    bool SetTolerance(double value) {
+        assert(value >= 0);
+        // --------------------------------
+        if((shape_ == NULL) || (shape_->Type() != SHAPE_BEZIER)) {
+            return false;
+        }
+
+        ((BezierShape *)shape_)->SetTolerance(value);
+        storyBoard_.Reset();
+        return true;
+    }
+
     SceneState State() { 
         return state_;
     }
@@ -92,26 +116,117 @@ public:
         state_ = state;
     }
 
+    // Opens a scene file. Files written before the container format
+    // was introduced are read by OpenLegacy.
+    // If the file can't be read the scene is left empty.
+    // If the file contains the frames of the animation and they are still
+    // valid, they are restored into the storyboard (see IsGenerated).
     bool Open(wchar_t *path) {
-        Stream stream(path, false);
-        
-        if(!stream.IsValid()) {
+        SceneContainer container;
+        ContainerStatus status = container.Open(path);
+
+        if(status == CONTAINER_UNKNOWN) {
+            container.Close();
+            return OpenLegacy(path);
+        }
+        else if(status != CONTAINER_OK) {
+            Clear();
+            return false;
+        }
+
+        Stream *shape = container.ReadSection(SECTION_SHAPE);
+        Stream *storyboard = container.ReadSection(SECTION_STORYBOARD);
+
+        if((shape == NULL) || (storyboard == NULL)) {
+            Clear();
+            return false;
+        }
+
+        ReadShape(*shape);
+
+        if((shape_ != NULL) && (container.Version() >= 2)) {
+            ReadShapeSettings(*shape);
+        }
+
+        storyboard->Read(storyBoard_);
+        storyBoard_.SetShapeObject(shape_);
+
+        if((shape_ == NULL) || shape->Failed() || storyboard->Failed()) {
+            Clear();
             return false;
         }
 
-        Deserialize(stream);
+        // A damaged or outdated cache is ignored, the frames are generated again.
+        Stream *frames = container.ReadSection(SECTION_FRAMES);
+
+        if(frames != NULL) {
+            unsigned int key = FrameCache::Key(*shape, *storyboard);
+
+            if(FrameCache::Read(*frames, key, storyBoard_.Frames())) {
+                storyBoard_.RestoreFrames();
+            }
+        }
+
         return true;
     }
 
-    bool Save(wchar_t *path) {
-        Sream stream(path, true);
-        
-        if(!stream.IsValid()) {
+    // Reads the format used before the container: the shape and the
+    // storyboard, one after the other, with no header. Sizes were stored
+    // using the size_t of the machine which wrote the file, so both 4 bytes
+    // (the 32 bit builds which wrote the files in Models) and 8 are tried.
+    // The file must be read exactly to its end.
+    bool OpenLegacy(wchar_t *path) {
+        Stream file(path);
+
+        if(!file.IsValid()) {
+            Clear();
             return false;
         }
 
-        Serialize(stream);
-        return true;
+        for(size_t width = 4; width <= 8; width += 4) {
+            Stream stream(file.Data(), file.Size());
+            stream.SetSizeWidth(width);
+            Deserialize(stream);
+
+            if((shape_ != NULL) && !stream.Failed() && (stream.Remaining() == 0)) {
+                return true;
+            }
+        }
+
+        Clear();
+        return false;
+    }
+
+    // With 'cacheFrames' the frames of the animation are saved too, so opening
+    // the scene doesn't need to evaluate them. If the animation was not played
+    // to its end, or the shape or actions changed since it was, the frames
+    // are evaluated from the current ones without changing the storyboard.
+    // Nothing is cached for a shape without points.
+    bool Save(wchar_t *path, bool cacheFrames = false) {
+        SceneContainer container;
+        Stream &shape = container.AddSection(SECTION_SHAPE);
+        shape.Write((int)shape_->Type());
+        shape.Write(*shape_);
+        WriteShapeSettings(shape);
+
+        Stream &storyboard = container.AddSection(SECTION_STORYBOARD);
+        storyboard.Write(storyBoard_);
+
+        if(cacheFrames && (storyBoard_.ActionCount() > 0) && (shape_->Points().Count() > 0)) {
+            unsigned int key = FrameCache::Key(shape, storyboard);
+            Stream &frames = container.AddSection(SECTION_FRAMES);
+
+            if(storyBoard_.IsGenerated()) {
+                FrameCache::Write(storyBoard_.Frames(), key, frames);
+            }
+            else {
+                FrameStore generated;
+                EvaluateFrames(generated);
+                FrameCache::Write(generated, key, frames);
+            }
+        }
+
+        return container.Save(path);
     }
 
     //
@@ -124,11 +239,28 @@ public:
     }
 
     virtual void Deserialize(Stream &stream) {
+        ReadShape(stream);
+
+        if(shape_ != NULL) {
+            stream.Read(storyBoard_);
+        }
+
+        storyBoard_.SetShapeObject(shape_);
+    }
+
+private:
+    void ReadShape(Stream &stream) {
         // Citeste figura.
         int temp;
         stream.Read(temp);
         ShapeType shapeType = (ShapeType)temp;
 
+        // The scene can be opened again, replacing the previous shape.
+        if(shape_ != NULL) {
+            delete shape_;
+            shape_ = NULL;
+        }
+
         switch(shapeType) {
             case SHAPE_BASIC: {
                 shape_ = new Shape();
@@ -140,10 +272,54 @@ public:
                 stream.Read(*(BezierShape *)shape_);
                 break;
             }
+            default: {
+                // Not a valid shape; the actions are not read either.
+                storyBoard_.ClearActions();
+                stream.SetFailed();
+                break;
+            }
         }
+    }
 
-        stream.Read(storyBoard_);
-        storyBoard_.SetShapeObject(shape_);
+    // The settings which are not part of the points of the shape,
+    // stored after them starting with version 2 of the container.
+    // Being in the shape section, they are covered by the key of the frames.
+    void WriteShapeSettings(Stream &stream) {
+        if(shape_->Type() == SHAPE_BEZIER) {
+            stream.Write(((BezierShape *)shape_)->Tolerance());
+        }
+    }
+
+    void ReadShapeSettings(Stream &stream) {
+        if(shape_->Type() == SHAPE_BEZIER) {
+            double tolerance;
+            stream.Read(tolerance);
+
+            // Rejects negative values and NaN.
+            if(stream.Failed() || !(tolerance >= 0)) {
+                stream.SetFailed();
+                return;
+            }
+
+            ((BezierShape *)shape_)->SetTolerance(tolerance);
+        }
+    }
+
+    void EvaluateFrames(FrameStore &frames) {
+        List<Point> points;
+        int count = storyBoard_.FrameCount();
+
+        for(int i = 0; i < count; i++) {
+            storyBoard_.EvaluateAt(i, points);
+            if(i == 0) frames.Reserve(count, points.Count());
+            frames.AddFrame().CopyFrom(Frame(points));
+        }
+    }
+
+    // Removes the shape and the actions of a scene which could not be read.
+    void Clear() {
+        SetShape(NULL);
+        storyBoard_.ClearActions();
     }
 };
 
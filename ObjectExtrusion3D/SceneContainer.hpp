@@ -0,0 +1,344 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SCENE_CONTAINER_HPP
+#define SCENE_CONTAINER_HPP
+
+#include "Stream.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+// Computes CRC-32 checksums (the polynomial used by zip and PNG).
+// Eight bytes are processed at once using eight tables ("slicing by 8"),
+// which makes checking large sections several times faster.
+class Crc32 {
+private:
+    struct Table {
+        unsigned int values[8][256];
+
+        Table() {
+            for(unsigned int i = 0; i < 256; i++) {
+                unsigned int value = i;
+
+                for(int bit = 0; bit < 8; bit++) {
+                    value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+                }
+
+                values[0][i] = value;
+            }
+
+            // values[k][i] is the CRC of byte i followed by k zero bytes.
+            for(int k = 1; k < 8; k++) {
+                for(unsigned int i = 0; i < 256; i++) {
+                    unsigned int previous = values[k - 1][i];
+                    values[k][i] = values[0][previous & 0xFF] ^ (previous >> 8);
+                }
+            }
+        }
+    };
+
+    static const Table table_;
+
+public:
+    // To compute the checksum of data split in several blocks, 
+    // pass the result for the previous blocks as 'crc'.
+    // The words are read in little endian order, like all values in the files.
+    static unsigned int Compute(const void *data, size_t size, unsigned int crc = 0) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        const unsigned int (*t)[256] = table_.values;
+        crc = ~crc;
+
+        while(size >= 8) {
+            unsigned int low;
+            unsigned int high;
+            memcpy(&low, bytes, 4);
+            memcpy(&high, bytes + 4, 4);
+            low ^= crc;
+
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+                  t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                  t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^
+                  t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+            bytes += 8;
+            size -= 8;
+        }
+
+        for(size_t i = 0; i < size; i++) {
+            crc = t[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+};
+
+const Crc32::Table Crc32::table_;
+
+
+enum ContainerStatus {
+    CONTAINER_OK,
+    CONTAINER_NOT_FOUND,   // The file can't be opened.
+    CONTAINER_UNKNOWN,     // Not a container (it can be an old scene file).
+    CONTAINER_INVALID      // A damaged or unsupported container.
+};
+
+// A file made of sections identified by a four character code.
+// The file starts with a header and the directory of the sections,
+// which gives the offset, size and checksum of each of them. 
+// A reader can go directly to a section and checks only the sections
+// it reads. All values are little endian with a fixed size
+// (sizes stored by the sections take 8 bytes), so the files can be
+// exchanged between 32 and 64 bit builds.
+class SceneContainer {
+public:
+    static const unsigned int MAGIC = 0x4433454F;      // "OE3D"
+    // Version 2 stores the tolerance of Bezier shapes in the shape section.
+    // The older versions can still be opened, see Version.
+    static const unsigned int VERSION = 2;
+    static const unsigned int MIN_VERSION = 1;
+    static const unsigned int BYTE_ORDER_MARK = 0x01020304; // Stored as 04 03 02 01.
+    static const size_t MAX_SECTIONS = 16;
+    static const size_t SECTION_ALIGNMENT = 8;
+
+private:
+    struct Header {
+        unsigned int Magic;
+        unsigned int Version;
+        unsigned int ByteOrder;
+        unsigned int SectionCount;
+        unsigned int DirectoryChecksum;
+        unsigned int Reserved;
+    };
+
+    struct SectionEntry {
+        unsigned int Id;
+        unsigned int Checksum;
+        unsigned long long Offset;
+        unsigned long long Size;
+    };
+
+    unsigned int ids_[MAX_SECTIONS];
+    Stream *sections_[MAX_SECTIONS]; // Written or being read.
+    SectionEntry entries_[MAX_SECTIONS];
+    size_t sectionCount_;
+    unsigned int version_;
+    Stream *file_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    SceneContainer() : sectionCount_(0), version_(VERSION), file_(NULL) {}
+
+    ~SceneContainer() {
+        Close();
+    }
+
+    //
+    // Public methods.
+    //
+    void Close() {
+        for(size_t i = 0; i < sectionCount_; i++) {
+            delete sections_[i];
+        }
+
+        delete file_;
+        file_ = NULL;
+        sectionCount_ = 0;
+        version_ = VERSION;
+    }
+
+    size_t SectionCount() const {
+        return sectionCount_;
+    }
+
+    // The version of the opened file, which tells the readers of the
+    // sections what they contain. Containers being written use VERSION.
+    unsigned int Version() const {
+        return version_;
+    }
+
+    //
+    // Writing.
+    //
+    // Returns the stream to which the contents of a new section are written.
+    Stream &AddSection(unsigned int id) {
+        assert(sectionCount_ < MAX_SECTIONS);
+        assert(file_ == NULL);
+        assert(FindSection(id) == -1);
+        // --------------------------------
+        Stream *stream = new Stream();
+        stream->SetSizeWidth(8);
+        ids_[sectionCount_] = id;
+        sections_[sectionCount_] = stream;
+        sectionCount_++;
+        return *stream;
+    }
+
+    bool Save(wchar_t *path) {
+        Stream file(path, true);
+        if(!file.IsValid()) return false;
+
+        // The sections follow the directory, each one aligned.
+        unsigned long long offset = sizeof(Header) + sectionCount_ * sizeof(SectionEntry);
+
+        for(size_t i = 0; i < sectionCount_; i++) {
+            offset = Align(offset);
+            Stream &section = *sections_[i];
+            SectionEntry &entry = entries_[i];
+            entry.Id = ids_[i];
+            entry.Checksum = Crc32::Compute(section.Data(), section.Size());
+            entry.Offset = offset;
+            entry.Size = section.Size();
+            offset += entry.Size;
+        }
+
+        Header header;
+        header.Magic = MAGIC;
+        header.Version = VERSION;
+        header.ByteOrder = BYTE_ORDER_MARK;
+        header.SectionCount = (unsigned int)sectionCount_;
+        header.DirectoryChecksum = Crc32::Compute(entries_, sectionCount_ * sizeof(SectionEntry));
+        header.Reserved = 0;
+
+        file.WriteBlock(&header, sizeof(Header));
+        file.WriteBlock(entries_, sectionCount_ * sizeof(SectionEntry));
+        offset = sizeof(Header) + sectionCount_ * sizeof(SectionEntry);
+
+        for(size_t i = 0; i < sectionCount_; i++) {
+            WritePadding(file, Align(offset) - offset);
+            file.WriteBlock(sections_[i]->Data(), (size_t)entries_[i].Size);
+            offset = entries_[i].Offset + entries_[i].Size;
+        }
+
+        file.Close();
+        return !file.Failed();
+    }
+
+    //
+    // Reading.
+    //
+    // Opens a container and checks its header and directory.
+    // The sections are checked only when they are read.
+    ContainerStatus Open(wchar_t *path) {
+        Close();
+        file_ = new Stream(path);
+        if(!file_->IsValid()) return CONTAINER_NOT_FOUND;
+
+        Header header;
+        if(file_->Size() < sizeof(Header)) return CONTAINER_UNKNOWN;
+
+        memcpy(&header, file_->Data(), sizeof(Header));
+        if(header.Magic != MAGIC) return CONTAINER_UNKNOWN;
+
+        // Files written by a newer version or on a big endian 
+        // machine are not supported.
+        if((header.Version < MIN_VERSION) || (header.Version > VERSION) || (header.ByteOrder != BYTE_ORDER_MARK) || 
+           (header.SectionCount > MAX_SECTIONS)) {
+            return CONTAINER_INVALID;
+        }
+
+        size_t directorySize = header.SectionCount * sizeof(SectionEntry);
+        if(file_->Size() < sizeof(Header) + directorySize) return CONTAINER_INVALID;
+
+        memcpy(entries_, file_->Data() + sizeof(Header), directorySize);
+
+        if(Crc32::Compute(entries_, directorySize) != header.DirectoryChecksum) {
+            return CONTAINER_INVALID;
+        }
+
+        for(size_t i = 0; i < header.SectionCount; i++) {
+            if((entries_[i].Offset > file_->Size()) || 
+               (entries_[i].Size > file_->Size() - entries_[i].Offset)) {
+                return CONTAINER_INVALID;
+            }
+
+            ids_[i] = entries_[i].Id;
+            sections_[i] = NULL;
+        }
+
+        sectionCount_ = header.SectionCount;
+        version_ = header.Version;
+        return CONTAINER_OK;
+    }
+
+    bool HasSection(unsigned int id) const {
+        return FindSection(id) != -1;
+    }
+
+    // Returns a stream which reads the section, after checking its checksum.
+    // Returns NULL if the section is missing or damaged.
+    // The stream is valid until the container is closed.
+    Stream *ReadSection(unsigned int id) {
+        assert(file_ != NULL);
+        // --------------------------------
+        int index = FindSection(id);
+        if(index == -1) return NULL;
+
+        if(sections_[index] == NULL) {
+            const SectionEntry &entry = entries_[index];
+            const char *data = file_->Data() + entry.Offset;
+
+            if(Crc32::Compute(data, (size_t)entry.Size) != entry.Checksum) {
+                return NULL;
+            }
+
+            sections_[index] = new Stream(data, (size_t)entry.Size);
+            sections_[index]->SetSizeWidth(8);
+        }
+
+        return sections_[index];
+    }
+
+private:
+    SceneContainer(const SceneContainer &other);
+    SceneContainer &operator =(const SceneContainer &other);
+
+    int FindSection(unsigned int id) const {
+        for(size_t i = 0; i < sectionCount_; i++) {
+            if(ids_[i] == id) return (int)i;
+        }
+
+        return -1;
+    }
+
+    static unsigned long long Align(unsigned long long offset) {
+        return (offset + SECTION_ALIGNMENT - 1) & ~(unsigned long long)(SECTION_ALIGNMENT - 1);
+    }
+
+    static void WritePadding(Stream &stream, unsigned long long count) {
+        char zeros[SECTION_ALIGNMENT] = { 0 };
+        stream.WriteBlock(zeros, (size_t)count);
+    }
+};
+
+#endif
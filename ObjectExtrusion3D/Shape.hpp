@@ -38,6 +38,7 @@
 #include "ISerializable.hpp"
 #include "Stream.hpp"
 #include <cmath>
+#include <utility>
 
 enum  ShapeType {
     SHAPE_BASIC,
@@ -56,6 +57,9 @@ public:
 
     Shape(const List<Point> &points) : points_(points) {}
 
+    // Takes the points without copying them.
+    Shape(List<Point> &&points) : points_(std::move(points)) {}
+
     virtual ~Shape() {}
 
     //
@@ -0,0 +1,180 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef STL_EXPORTER_HPP
+#define STL_EXPORTER_HPP
+
+#include "Point.hpp"
+#include "List.hpp"
+#include "Storyboard.hpp"
+#include "Stream.hpp"
+#include <cstring>
+#include <cmath>
+
+// Writes the surface swept by the shape of a storyboard as a binary STL file.
+// The frames are evaluated one after another directly from the storyboard
+// and their triangles are written in blocks, so only two frames and 
+// a block are kept in memory, no matter how large the model is.
+// The triangles are the same as the ones built by MeshBuilder.
+class StlExporter {
+private:
+    static const size_t HEADER_SIZE = 80;
+    static const size_t TRIANGLE_SIZE = 50;
+    static const size_t TRIANGLES_PER_BLOCK = 8192;
+
+    unsigned char *block_;
+    size_t blockCount_;   // Number of triangles in the block.
+    size_t triangleCount_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    StlExporter() : blockCount_(0), triangleCount_(0) {
+        block_ = new unsigned char[TRIANGLES_PER_BLOCK * TRIANGLE_SIZE];
+    }
+
+    ~StlExporter() {
+        delete[] block_;
+    }
+
+    //
+    // Public methods.
+    //
+    // Returns the number of triangles written by the last export.
+    size_t TriangleCount() const {
+        return triangleCount_;
+    }
+
+    // Returns false if the file can't be written or the model
+    // has more triangles than the format can store.
+    bool Save(Storyboard &storyboard, wchar_t *path) {
+        Stream stream(path, true);
+        
+        if(!stream.IsValid()) {
+            return false;
+        }
+
+        bool written = Write(storyboard, stream);
+        stream.Close();
+        return written && !stream.Failed();
+    }
+
+    // Returns false without writing anything if the number 
+    // of triangles doesn't fit in the 32 bits of the header.
+    bool Write(Storyboard &storyboard, Stream &stream) {
+        List<Point> frames[2];
+        int frameCount = storyboard.FrameCount();
+        blockCount_ = 0;
+        triangleCount_ = 0;
+
+        if(frameCount > 0) {
+            storyboard.EvaluateAt(0, frames[0]);
+        }
+
+        // The number of triangles is known before generating any of them.
+        size_t pointCount = frames[0].Count();
+        unsigned long long triangles = (frameCount > 1) && (pointCount > 1) ?
+            (unsigned long long)(frameCount - 1) * (pointCount - 1) * 2 : 0;
+
+        if(triangles > 0xFFFFFFFFu) {
+            return false;
+        }
+
+        char header[HEADER_SIZE];
+        memset(header, 0, HEADER_SIZE);
+        strcpy(header, "Binary STL written by ObjectExtrusion3D");
+        stream.WriteBlock(header, HEADER_SIZE);
+        stream.WriteInt((int)(unsigned int)triangles);
+
+        for(int i = 1; i < frameCount; i++) {
+            List<Point> &previous = frames[(i - 1) % 2];
+            List<Point> &current = frames[i % 2];
+            storyboard.EvaluateAt(i, current);
+
+            for(size_t j = 0; j + 1 < pointCount; j++) {
+                AddTriangle(previous[j], current[j + 1], current[j], stream);
+                AddTriangle(previous[j], previous[j + 1], current[j + 1], stream);
+            }
+        }
+
+        FlushBlock(stream);
+        return true;
+    }
+
+private:
+    void AddTriangle(const Point &a, const Point &b, const Point &c, Stream &stream) {
+        double px = b.X - a.X;
+        double py = b.Y - a.Y;
+        double pz = b.Z - a.Z;
+        double qx = c.X - a.X;
+        double qy = c.Y - a.Y;
+        double qz = c.Z - a.Z;
+
+        double nx = py * qz - pz * qy;
+        double ny = pz * qx - px * qz;
+        double nz = px * qy - py * qx;
+        double magnitude = sqrt(nx * nx + ny * ny + nz * nz);
+
+        if(magnitude > 0) {
+            nx /= magnitude;
+            ny /= magnitude;
+            nz /= magnitude;
+        }
+
+        // Normal, the three vertices and an unused attribute word.
+        float values[12] = { (float)nx,  (float)ny,  (float)nz,
+                             (float)a.X, (float)a.Y, (float)a.Z,
+                             (float)b.X, (float)b.Y, (float)b.Z,
+                             (float)c.X, (float)c.Y, (float)c.Z };
+        unsigned char *triangle = block_ + blockCount_ * TRIANGLE_SIZE;
+        memcpy(triangle, values, sizeof(values));
+        memset(triangle + sizeof(values), 0, 2);
+
+        triangleCount_++;
+        blockCount_++;
+
+        if(blockCount_ == TRIANGLES_PER_BLOCK) {
+            FlushBlock(stream);
+        }
+    }
+
+    void FlushBlock(Stream &stream) {
+        stream.WriteBlock(block_, blockCount_ * TRIANGLE_SIZE);
+        blockCount_ = 0;
+    }
+
+    StlExporter(const StlExporter &other);
+    StlExporter &operator =(const StlExporter &other);
+};
+
+#endif
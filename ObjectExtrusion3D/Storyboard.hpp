@@ -34,6 +34,10 @@
 #define STORYBOARD_HPP
 
 #include "List.hpp"
+#include "FrameStore.hpp"
+#include "Transform.hpp"
+#include "PointBuffer.hpp"
+#include "ThreadPool.hpp"
 #include "IAction.hpp"
 #include "Shape.hpp"
 #include "ISerializable.hpp"
@@ -44,14 +48,48 @@
 
 class Storyboard {
 private:
-    typedef List<Point> PointList;
+    // Evaluates a range of frames from the shape (the first frame).
+    // The points of large shapes are also split between the threads,
+    // so a few frames of a dense shape still use the whole pool.
+    template <class P>
+    class FrameTask : public IRangeTask {
+    private:
+        Storyboard *storyboard_;
+        BasicFrameStore<P> *frames_;
+        ThreadPool *pool_;
+        size_t first_;
+
+    public:
+        FrameTask(Storyboard *storyboard, BasicFrameStore<P> *frames, 
+                  ThreadPool *pool, size_t first) : 
+                storyboard_(storyboard), frames_(frames), pool_(pool), first_(first) {}
+
+        virtual void Run(size_t begin, size_t end) {
+            BasicFrameStore<P> &frames = *frames_;
+
+            for(size_t i = std::max(first_ + begin, (size_t)1); i < first_ + end; i++) {
+                BasicFrame<P> points = frames[i];
+                storyboard_->transforms_[i].Apply(frames[0], points, pool_);
+            }
+        }
+    };
+
+    static const size_t POINTS_PER_TASK = 16384;
 
     List<IAction *> actions_;
     IAction* currentAction_;
-    size_t currentPosition_;
-    int currentStep_;
-    List<PointList *> points_;
+    FrameStore frames_;
     Shape* shape_;
+    List<Point> profile_;       // The shape points the storyboard was compiled for.
+    List<IAction *> compiledActions_; // and the actions.
+    PointBuffer profileBuffer_;
+    PointBufferF profileBufferF_;
+    List<Transform> transforms_; // Transforms from the shape to each frame.
+    List<size_t> frameActions_;  // The action which generated each frame.
+    List<size_t> checkpointActions_; // The first action of each group of linked actions
+    List<size_t> checkpointFrames_;  // and the frame before the group (its checkpoint).
+    List<Point> scratch_;
+    bool compiled_;
 
 public:
     //
@@ -83,6 +121,7 @@ public:
         }
 
         actions_.Clear();
+        compiled_ = false;
     }
 
     Shape* ShapeObject() { 
@@ -91,6 +130,7 @@ public:
 
     void SetShapeObject(Shape *value) {
         shape_ = value; 
+        compiled_ = false;
     }
 
     int TotalSteps() {
@@ -107,90 +147,232 @@ public:
         return currentAction_; 
     }
 
-    List<PointList*>& Points() { 
-        return points_; 
+    FrameStore& Frames() { 
+        return frames_; 
+    }
+
+    // Computes the transform that takes the shape to each frame.
+    // The steps of a group of linked actions are composed into a single
+    // transform, so generating a frame is one pass over the points.
+    // The points of the shape are evaluated just at the start of each
+    // group and for the actions whose transform depends on them.
+    void Compile() {
+        transforms_.Clear();
+        frameActions_.Clear();
+        checkpointActions_.Clear();
+        checkpointFrames_.Clear();
+        profile_.Clear();
+        compiledActions_.Clear();
+        compiledActions_.Add(actions_);
+        compiled_ = true;
+
+        if(shape_ == NULL) return;
+        profile_.Add(shape_->Points());
+        profileBuffer_.CopyFrom(profile_);
+        profileBufferF_.CopyFrom(profile_);
+
+        transforms_.Add(Transform());
+        frameActions_.Add(0);
+        CompileFrom(0);
+    }
+
+    // Should be called after the properties of an action were changed.
+    // Only the frames generated by the action and the ones after it are
+    // recomputed, starting from the checkpoint before its group of linked actions.
+    // The frames generated so far are updated (all of them if playing ended).
+    // Returns the first frame which was recomputed.
+    // If actions were added or removed, or the shape changed, since the
+    // storyboard was compiled, everything is compiled and recomputed.
+    size_t ActionChanged(IAction *action, ThreadPool *pool = NULL) {
+        if(!compiled_ || (shape_ == NULL)) return 0;
+
+        if(IsOutdated()) {
+            RecompileAll(pool);
+            return 0;
+        }
+
+        size_t index = 0;
+        while((index < actions_.Count()) && (actions_[index] != action)) {
+            index++;
+        }
+
+        assert(index < actions_.Count());
+        // --------------------------------
+        // The action could have been linked or unlinked from the previous one,
+        // so restart from the group it belongs to now, if it's an earlier one.
+        size_t start = index;
+        while((start > 0) && actions_[start]->WithPrevious()) {
+            start--;
+        }
+
+        size_t checkpoint = checkpointActions_.Count() - 1;
+        while(checkpointActions_[checkpoint] > std::min(start, index)) {
+            checkpoint--;
+        }
+
+        size_t position = checkpointActions_[checkpoint];
+        size_t firstFrame = checkpointFrames_[checkpoint] + 1;
+        bool ended = frames_.Count() == transforms_.Count();
+
+        checkpointActions_.Truncate(checkpoint);
+        checkpointFrames_.Truncate(checkpoint);
+        transforms_.Truncate(firstFrame);
+        frameActions_.Truncate(firstFrame);
+        CompileFrom(position);
+
+        // Recompute the frames after the checkpoint.
+        if(frames_.Count() > 0) {
+            size_t frameCount = ended ? transforms_.Count() : 
+                                std::min(frames_.Count(), transforms_.Count());
+            frames_.Truncate(std::min(firstFrame, frameCount));
+
+            while(frames_.Count() < frameCount) {
+                frames_.AddFrame();
+            }
+
+            if(frameCount > firstFrame) {
+                EvaluateFrames(frames_, firstFrame, pool);
+            }
+
+            currentAction_ = actions_[frameActions_[frames_.Count() - 1]];
+        }
+
+        return firstFrame;
+    }
+
+    // Returns the number of frames the storyboard generates,
+    // including the first one, which contains the shape itself.
+    int FrameCount() {
+        EnsureCompiled();
+        return (int)transforms_.Count();
+    }
+
+    // Computes the points of the given frame directly from the shape,
+    // without generating the frames before it.
+    // The storyboard is compiled again if the points of the shape
+    // or the list of actions changed since it was compiled.
+    void EvaluateAt(int globalStep, List<Point> &points) {
+        EnsureCompiled();
+        assert((globalStep >= 0) && (globalStep < (int)transforms_.Count()));
+        // --------------------------------
+        EvaluateProfile(transforms_[globalStep], points);
+    }
+
+    void EvaluateAt(int globalStep, PointBuffer &points) {
+        EnsureCompiled();
+        assert((globalStep >= 0) && (globalStep < (int)transforms_.Count()));
+        // --------------------------------
+        profileBuffer_.Apply(transforms_[globalStep], points);
+    }
+
+    void EvaluateAt(int globalStep, PointBufferF &points) {
+        EnsureCompiled();
+        assert((globalStep >= 0) && (globalStep < (int)transforms_.Count()));
+        // --------------------------------
+        profileBufferF_.Apply(transforms_[globalStep], points);
     }
 
     void Play() {
         if(actions_.Count() == 0) return;
 
+        Compile();
         currentAction_ = actions_[0];
-        currentPosition_ = 0;
-        currentStep_ = 0;
 
-        List<Point> *firstPoints = new List<Point>(shape_->Points());
-        points_.Add(firstPoints);
+        // Reserve space for all frames up front, so that playing
+        // the animation doesn't need to allocate anymore.
+        frames_.Reserve(transforms_.Count(), profile_.Count());
 
-        // Initialize the start action and the ones connected to it.
-        currentAction_->Initialize(*firstPoints);
+        Frame firstPoints = frames_.AddFrame();
+        firstPoints.CopyFrom(Frame(profile_));
+    }
 
-        for(size_t i = 1; i < actions_.Count(); i++) {
-            if(actions_[i]->WithPrevious() == false) return;
-            actions_[i]->Initialize(*firstPoints);
+    // Generates all frames at once. Each frame depends only on the shape
+    // and its own transform, so with a thread pool the frames are
+    // evaluated in parallel, giving the same results as NextStep.
+    void GenerateFrames(ThreadPool *pool = NULL) {
+        Play();
+        if(frames_.Count() == 0) return;
+
+        while(frames_.Count() < transforms_.Count()) {
+            frames_.AddFrame();
         }
+
+        EvaluateFrames(frames_, 0, pool);
+        currentAction_ = actions_[frameActions_[frames_.Count() - 1]];
     }
 
-    bool NextStep() {
-        if(actions_.Count() == 0) return false;
-        List<Point>* prevPoints = points_[points_.Count() - 1];
+    // Generates all frames in float precision into the given store,
+    // for the float32 pipeline. Uses half the memory and bandwidth of
+    // the double frames; the storyboard's own frames are not changed.
+    void GenerateFrames(FrameStoreF &frames, ThreadPool *pool = NULL) {
+        Compile();
+        frames.Clear();
+        if(actions_.Count() == 0) return;
 
-        // Check if the next action should be executed.
-        if(currentStep_ == currentAction_->Steps()) {
-            // Skip over all connected actions.
-            size_t nextPosition = currentPosition_ + 1;
-            while(nextPosition < actions_.Count() && actions_[nextPosition]->WithPrevious()) {
-                nextPosition++;
-            }
+        frames.Reserve(transforms_.Count(), profile_.Count());
+        FrameF firstPoints = frames.AddFrame();
+        profileBufferF_.CopyTo(firstPoints);
 
-            size_t i = nextPosition + 1;
-            while((i < actions_.Count()) && actions_[i]->WithPrevious()) {
-                actions_[i]->Initialize(*prevPoints);
-                i++;
-            }
+        while(frames.Count() < transforms_.Count()) {
+            frames.AddFrame();
+        }
 
-            if(nextPosition < actions_.Count()) {
-                // Advance to the next action.
-                currentAction_ = actions_[nextPosition];
-                currentAction_->Initialize(*prevPoints);
-                currentPosition_ = nextPosition;
-                currentStep_ = 0;
-            }
-            else {
-                // All actions have been executed.
-                return false; 
-            }
+        EvaluateFrames(frames, 0, pool);
+    }
+
+    // Returns true if all frames were generated (the animation was played
+    // to its end, or the frames were restored) and they are up to date,
+    // which they're not if the shape or the actions changed since then.
+    bool IsGenerated() {
+        return !IsOutdated() && (frames_.Count() > 0) && (frames_.Count() == transforms_.Count());
+    }
+
+    // Uses the frames placed in the store (read from a cache) as if the
+    // animation was played to its end, without evaluating them.
+    // The frames are removed if they don't match the ones the storyboard generates.
+    bool RestoreFrames() {
+        Compile();
+
+        if((actions_.Count() == 0) || (frames_.Count() != transforms_.Count()) ||
+           (frames_.PointCount() != profile_.Count())) {
+            frames_.Clear();
+            currentAction_ = NULL;
+            return false;
         }
 
-        // Compute the next state of the shape.
-        // The generated points depend directly on the previous ones.
-        List<Point>* newPoints = new List<Point>(*prevPoints);
-        points_.Add(newPoints);
+        // The first frame is the shape itself, which is known exactly.
+        frames_[0].CopyFrom(Frame(profile_));
+        currentAction_ = actions_[frameActions_[frames_.Count() - 1]];
+        return true;
+    }
 
-        // Apply to the points the current action and all actions liked with it.
-        currentAction_->Execute(currentStep_, *newPoints);
+    // Generates the next frame. With a thread pool, the points
+    // of large shapes are transformed in parallel.
+    bool NextStep(ThreadPool *pool = NULL) {
+        if(frames_.Count() == 0) return false;
 
-        for(size_t i = currentPosition_ + 1; i < actions_.Count(); i++) {
-            if(actions_[i]->WithPrevious()) {
-                actions_[i]->Execute(currentStep_, *newPoints);
-            }
-            else break;
+        if(frames_.Count() == transforms_.Count()) {
+            // All actions have been executed.
+            return false;
         }
 
-        currentStep_++;
+        // Compute the next state of the shape by applying the transform
+        // of all steps so far (for all linked actions) to the shape.
+        Frame newPoints = frames_.AddFrame();
+        size_t frame = frames_.Count() - 1;
+
+        currentAction_ = actions_[frameActions_[frame]];
+        transforms_[frame].Apply(frames_[0], newPoints, pool);
         return true;
     }
 
     void Reset() {
         currentAction_ = NULL;
-        currentPosition_ = 0;
-        currentStep_ = 0;
-
-        // Remove all computed points in the current step.
-        for(size_t i = 0; i < points_.Count(); i++) {
-            delete points_[i];
-        }
 
-        points_.Clear();
+        // Remove all computed frames. The memory is kept
+        // and reused the next time the storyboard is played.
+        frames_.Clear();
+        compiled_ = false;
     }
 
     //
@@ -208,10 +390,11 @@ public:
 
     virtual void Deserialize(Stream &stream) {
         ClearActions();
+        Reset();
         size_t count;
         stream.Read(count);
 
-        for(size_t i = 0; i < count; i++) {
+        for(size_t i = 0; (i < count) && !stream.Failed(); i++) {
             int temp;
             stream.Read(temp);
             ActionType type = (ActionType)temp;
@@ -235,7 +418,142 @@ public:
                     actions_.Add(action);
                     break;
                 }
+                default: {
+                    // Not a valid action; the rest can't be read.
+                    stream.SetFailed();
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    // The points of the shape can be changed through the list returned by
+    // Points and the actions through Actions, without the storyboard
+    // being told, so they are compared with the ones it was compiled for.
+    bool IsOutdated() {
+        if(!compiled_) return true;
+        if(actions_.Count() != compiledActions_.Count()) return true;
+
+        for(size_t i = 0; i < actions_.Count(); i++) {
+            if(actions_[i] != compiledActions_[i]) return true;
+        }
+
+        if(shape_ == NULL) return false;
+        List<Point> &points = shape_->Points();
+        if(points.Count() != profile_.Count()) return true;
+
+        // Compared exactly, Point::operator == allows a small difference.
+        for(size_t i = 0; i < points.Count(); i++) {
+            const Point &a = points[i];
+            const Point &b = profile_[i];
+            if((a.X != b.X) || (a.Y != b.Y) || (a.Z != b.Z)) return true;
+        }
+
+        return false;
+    }
+
+    // Compiles the storyboard and recomputes the frames generated so far
+    // (all of them if playing ended). The number of points can be different.
+    void RecompileAll(ThreadPool *pool) {
+        size_t generated = frames_.Count();
+        bool ended = (generated > 0) && (generated == transforms_.Count());
+        Compile();
+        frames_.Clear();
+        currentAction_ = NULL;
+        if((generated == 0) || (actions_.Count() == 0)) return;
+
+        size_t frameCount = ended ? transforms_.Count() : 
+                            std::min(generated, transforms_.Count());
+        frames_.Reserve(transforms_.Count(), profile_.Count());
+        frames_.AddFrame().CopyFrom(Frame(profile_));
+
+        while(frames_.Count() < frameCount) {
+            frames_.AddFrame();
+        }
+
+        EvaluateFrames(frames_, 1, pool);
+        currentAction_ = actions_[frameActions_[frames_.Count() - 1]];
+    }
+
+    void EnsureCompiled() {
+        if(!IsOutdated()) return;
+
+        // The frames generated for the previous shape or actions are not valid.
+        if(compiled_) {
+            frames_.Clear();
+            currentAction_ = NULL;
+        }
+
+        Compile();
+    }
+
+    // Computes the transforms of the frames generated by the actions
+    // starting with 'position', which must be the first of its group.
+    void CompileFrom(size_t position) {
+        Transform current = transforms_[transforms_.Count() - 1];
+
+        while(position < actions_.Count()) {
+            // Find the actions linked with the current one.
+            size_t groupEnd = position + 1;
+            while(groupEnd < actions_.Count() && actions_[groupEnd]->WithPrevious()) {
+                groupEnd++;
+            }
+
+            checkpointActions_.Add(position);
+            checkpointFrames_.Add(transforms_.Count() - 1);
+
+            EvaluateProfile(current, scratch_);
+            Frame startPoints(scratch_);
+
+            for(size_t i = position; i < groupEnd; i++) {
+                actions_[i]->Initialize(startPoints);
+            }
+
+            // The linked actions are executed as many times as the first one.
+            for(int step = 0; step < actions_[position]->Steps(); step++) {
+                for(size_t i = position; i < groupEnd; i++) {
+                    if(actions_[i]->NeedsPoints()) {
+                        EvaluateProfile(current, scratch_);
+                    }
+
+                    Transform stepTransform = actions_[i]->StepTransform(step, Frame(scratch_));
+                    current = stepTransform * current;
+
+                    for(size_t j = position; j < groupEnd; j++) {
+                        actions_[j]->PointsTransformed(stepTransform);
+                    }
+                }
+
+                transforms_.Add(current);
+                frameActions_.Add(position);
             }
+
+            position = groupEnd;
+        }
+    }
+
+    // Evaluates the frames starting with 'first' (which were already added).
+    template <class P>
+    void EvaluateFrames(BasicFrameStore<P> &frames, size_t first, ThreadPool *pool) {
+        // Make each task large enough to be worth scheduling.
+        size_t grain = std::max((size_t)1, POINTS_PER_TASK / std::max((size_t)1, profile_.Count()));
+        FrameTask<P> task(this, &frames, pool, first);
+        size_t count = frames.Count() - first;
+
+        if(pool != NULL) {
+            pool->ParallelFor(task, count, grain);
+        }
+        else {
+            task.Run(0, count);
+        }
+    }
+
+    void EvaluateProfile(const Transform &transform, List<Point> &points) {
+        points.Clear();
+
+        for(size_t i = 0; i < profile_.Count(); i++) {
+            points.Add(transform.Apply(profile_[i]));
         }
     }
 };
@@ -33,8 +33,31 @@
 #ifndef STREAM_HPP
 #define STREAM_HPP
 
-#include <Windows.h>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
 
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX // Keeps std::min and std::max usable.
+    #endif
+    #include <Windows.h>
+#else
+    #include <cstdio>
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+// A binary file opened either for reading or for writing.
+// Files opened for reading are memory-mapped, so reading a value is only
+// a copy from the mapped view. Writes are collected in a buffer and
+// written to the file in large blocks.
+// A stream can also write to a growing block of memory, 
+// or read from a block of memory owned by someone else.
 class Stream {
 private:
     template <class T>
@@ -56,65 +79,83 @@ private:
         static void Read(T* value, Stream &stream) {}
     };
 
-    template <>
-    struct Helper<char> {
-        static void Write(const char &value, Stream &stream) { stream.WriteChar(value); }
-        static void Read(char &value, Stream &stream) { stream.ReadChar(value); }
-    };
-
-    template <>
-    struct Helper<wchar_t> {
-        static void Write(const wchar_t &value, Stream &stream) { stream.WriteWChar(value); }
-        static void Read(wchar_t &value, Stream &stream) { stream.ReadWChar(value); }
-    };
-
-    template <>
-    struct Helper<short int> {
-        static void Write(const short int &value, Stream &stream) { stream.WriteShort(value); }
-        static void Read(short int &value, Stream &stream) { stream.ReadShort(value); }
-    };
-
-    template <>
-    struct Helper<int> {
-        static void Write(const int &value, Stream &stream) { stream.WriteInt(value); }
-        static void Read(int &value, Stream &stream) { stream.ReadInt(value); }
-    };
+    // Arrays are written one item at a time, unless there is a
+    // specialization for the item type (the basic types, Point).
+    template <class T>
+    struct ArrayHelper {
+        static void Write(const T *items, size_t count, Stream &stream) {
+            for(size_t i = 0; i < count; i++) {
+                Helper<T>::Write(items[i], stream);
+            }
+        }
 
-    template <>
-    struct Helper<float> {
-        static void Write(const float &value, Stream &stream) { stream.WriteFloat(value); }
-        static void Read(float &value, Stream &stream) { stream.ReadFloat(value); } 
+        static void Read(T *items, size_t count, Stream &stream) {
+            for(size_t i = 0; i < count; i++) {
+                Helper<T>::Read(items[i], stream);
+            }
+        }
     };
 
-    template <>
-    struct Helper<double> {
-        static void Write(const double &value, Stream &stream) { stream.WriteDouble(value); }
-        static void Read(double &value, Stream &stream) { stream.ReadDouble(value); }
-    };
+    // Arrays of basic types are stored exactly as in memory,
+    // so they are copied as a single block.
+    template <class T>
+    struct BlockArrayHelper {
+        static void Write(const T *items, size_t count, Stream &stream) {
+            stream.WriteBlock(items, count * sizeof(T));
+        }
 
-    template <>
-    struct Helper<size_t> {
-        static void Write(const size_t &value, Stream &stream) { stream.WriteSizeT(value); }
-        static void Read(size_t &value, Stream &stream) { stream.ReadSizeT(value); }
+        static void Read(T *items, size_t count, Stream &stream) {
+            stream.ReadBlock(items, count * sizeof(T));
+        }
     };
 
-    template <>
-    struct Helper<bool> {
-        static void Write(const bool &value, Stream &stream) { stream.WriteBool(value); }
-        static void Read(bool &value, Stream &stream) { stream.ReadBool(value); }
-    };
+    static const size_t WRITE_BUFFER_SIZE = 65536;
 
-    HANDLE stream_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int file_;
+#endif
+    bool write_;
+    bool memory_;
+    bool failed_;
+    const char *view_;     // The mapped file or memory block, when reading.
+    size_t size_;
+    size_t position_;
+    char *buffer_;         // The pending writes (all writes for memory streams).
+    size_t buffered_;
+    size_t bufferCapacity_;
+    size_t sizeWidth_;     // The number of bytes used to store a size_t.
 
 public:
     //
     // Constructors / destructor.
     //
-    Stream(wchar_t *path, bool write = false) {
+    Stream(wchar_t *path, bool write = false) : write_(false), memory_(false), 
+            failed_(false), view_(NULL), size_(0), position_(0), buffer_(NULL),
+            buffered_(0), bufferCapacity_(0), sizeWidth_(sizeof(size_t)) {
+        InitializeFile();
         Open(path, write);
     }
 
-    ~Stream() {
+    // Creates a stream which writes to memory (see Data).
+    Stream() : write_(true), memory_(true), failed_(false), view_(NULL), 
+               size_(0), position_(0), buffered_(0), 
+               bufferCapacity_(WRITE_BUFFER_SIZE), sizeWidth_(sizeof(size_t)) {
+        InitializeFile();
+        buffer_ = new char[bufferCapacity_];
+    }
+
+    // Creates a stream which reads the given block of memory.
+    // The memory must remain valid while the stream is used.
+    Stream(const void *data, size_t size) : write_(false), memory_(true), 
+            failed_(false), view_((const char *)data), size_(size), position_(0), 
+            buffer_(NULL), buffered_(0), bufferCapacity_(0), sizeWidth_(sizeof(size_t)) {
+        InitializeFile();
+    }
+
+    virtual ~Stream() {
         Close();
     }
 
@@ -122,20 +163,98 @@ public:
     // Public methods.
     //
     bool IsValid() { 
-        return stream_ != INVALID_HANDLE_VALUE; 
+        return IsOpen() || memory_;
     }
 
     bool Open(wchar_t *path, bool write = false) {
-        unsigned long openMode = write ? CREATE_ALWAYS : OPEN_EXISTING;
+        Close();
+        write_ = write;
+        memory_ = false;
+        failed_ = false;
+        position_ = 0;
+        size_ = 0;
+
+        bool opened = write ? OpenWrite(path) : OpenRead(path);
+
+        if(!opened) {
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void Close() {
+        if(IsOpen() && write_) {
+            Flush();
+        }
 
-        stream_ = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 
-                             FILE_SHARE_READ, NULL, openMode, 
-                             FILE_ATTRIBUTE_NORMAL, NULL);
-        return stream_ != INVALID_HANDLE_VALUE;
+        // The memory read by a memory stream is not owned.
+        if(!memory_) {
+            CloseFile();
+        }
+
+        delete[] buffer_;
+        buffer_ = NULL;
+        buffered_ = 0;
+        view_ = NULL;
+        memory_ = false;
+    }
+
+    // Writes the buffered data to the file.
+    void Flush() {
+        if(memory_) return;
+
+        if(buffered_ > 0) {
+            if(!WriteFileBytes(buffer_, buffered_)) {
+                failed_ = true;
+            }
+
+            buffered_ = 0;
+        }
     }
 
-    void Close() { 
-        CloseHandle(stream_); 
+    // The size of the file opened for reading, or the number
+    // of bytes written so far.
+    size_t Size() const {
+        return write_ ? position_ : size_;
+    }
+
+    size_t Position() const {
+        return position_;
+    }
+
+    // The number of bytes which can still be read.
+    size_t Remaining() const {
+        return write_ ? 0 : size_ - position_;
+    }
+
+    // The data of a stream which reads or writes memory,
+    // or of a file opened for reading.
+    const char *Data() const {
+        return write_ ? buffer_ : view_;
+    }
+
+    // True if a read went past the end of the file or a write failed.
+    bool Failed() const {
+        return failed_;
+    }
+
+    // Used by readers which find invalid data.
+    void SetFailed() {
+        failed_ = true;
+    }
+
+    // The number of bytes used to store a size_t value (4 or 8).
+    // By default it's the size on the current platform.
+    size_t SizeWidth() const {
+        return sizeWidth_;
+    }
+
+    void SetSizeWidth(size_t width) {
+        assert((width == 4) || (width == 8));
+        // --------------------------------
+        sizeWidth_ = width;
     }
 
     void WriteChar(char value)        { WriteBytes(&value, sizeof(char));      }
@@ -144,7 +263,7 @@ public:
     void WriteInt(int value)          { WriteBytes(&value, sizeof(int));       }
     void WriteFloat(float value)      { WriteBytes(&value, sizeof(float));     }
     void WriteDouble(double value)    { WriteBytes(&value, sizeof(double));    }
-    void WriteSizeT(size_t value)     { WriteBytes(&value, sizeof(size_t));    }
+    void WriteSizeT(size_t value)     { WriteSize(value);                      }
     void WriteBool(bool value)        { WriteBytes(&value, sizeof(bool)); }
 
     template<class T>
@@ -152,13 +271,24 @@ public:
         Helper<T>::Write(value, *this);
     }
 
+    // Writes 'count' items; the result is the same as writing them one by one.
+    template<class T>
+    void WriteArray(const T *items, size_t count) {
+        ArrayHelper<T>::Write(items, count, *this);
+    }
+
+    // Writes a block of bytes with a single call.
+    void WriteBlock(const void *data, size_t size) {
+        WriteBytes(const_cast<void *>(data), size);
+    }
+
     void ReadChar(char &value)        { ReadBytes(&value, sizeof(char));      }
     void ReadWChar(wchar_t &value)    { ReadBytes(&value, sizeof(wchar_t));   }
     void ReadShort(short int &value)  { ReadBytes(&value, sizeof(short int)); }
     void ReadInt(int &value)          { ReadBytes(&value, sizeof(int));       }
     void ReadFloat(float &value)      { ReadBytes(&value, sizeof(float));     }
     void ReadDouble(double &value)    { ReadBytes(&value, sizeof(double));    }
-    void ReadSizeT(size_t &value)     { ReadBytes(&value, sizeof(size_t));    }
+    void ReadSizeT(size_t &value)     { ReadSize(value);                      }
     void ReadBool(bool &value)        { ReadBytes(&value, sizeof(bool));      }
 
     template<class T>
@@ -166,15 +296,318 @@ public:
         Helper<T>::Read(value, *this);
     }
 
+    template<class T>
+    void ReadArray(T *items, size_t count) {
+        ArrayHelper<T>::Read(items, count, *this);
+    }
+
+    void ReadBlock(void *data, size_t size) {
+        ReadBytes(data, size);
+    }
+
 protected:
     virtual void WriteBytes(void *data, size_t size) {
-        unsigned long written;
-        WriteFile(stream_, data, size, &written, NULL);
+        assert(write_ || !IsValid());
+        // --------------------------------
+        if(!IsValid()) {
+            failed_ = true;
+            return;
+        }
+
+        if(memory_) {
+            if(buffered_ + size > bufferCapacity_) {
+                GrowBuffer(buffered_ + size);
+            }
+        }
+        else if(buffered_ + size > WRITE_BUFFER_SIZE) {
+            Flush();
+
+            // Large blocks are written directly.
+            if(size >= WRITE_BUFFER_SIZE) {
+                if(!WriteFileBytes(data, size)) {
+                    failed_ = true;
+                }
+
+                position_ += size;
+                return;
+            }
+        }
+
+        memcpy(buffer_ + buffered_, data, size);
+        buffered_ += size;
+        position_ += size;
     }
 
     virtual void ReadBytes(void *data, size_t size) {
-        unsigned long read;
-        ReadFile(stream_, data, size, &read, NULL);
+        assert(!write_ || !IsValid());
+        // --------------------------------
+        size_t available = size_ - position_;
+
+        if(size > available) {
+            // Past the end of the file; the missing bytes are read as zero.
+            memcpy(data, view_ + position_, available);
+            memset((char *)data + available, 0, size - available);
+            position_ = size_;
+            failed_ = true;
+            return;
+        }
+
+        memcpy(data, view_ + position_, size);
+        position_ += size;
+    }
+
+private:
+    Stream(const Stream &other);
+    Stream &operator =(const Stream &other);
+
+    void GrowBuffer(size_t size) {
+        size_t capacity = std::max(bufferCapacity_ * 2, size);
+        char *buffer = new char[capacity];
+        memcpy(buffer, buffer_, buffered_);
+        delete[] buffer_;
+        buffer_ = buffer;
+        bufferCapacity_ = capacity;
+    }
+
+    // Sizes are stored with the selected width, in little endian order.
+    void WriteSize(size_t value) {
+        if(sizeWidth_ == sizeof(size_t)) {
+            WriteBytes(&value, sizeof(size_t));
+        }
+        else if(sizeWidth_ == 8) {
+            unsigned long long wide = value;
+            WriteBytes(&wide, 8);
+        }
+        else {
+            unsigned int narrow = (unsigned int)value;
+            if(narrow != value) failed_ = true;
+            WriteBytes(&narrow, 4);
+        }
+    }
+
+    void ReadSize(size_t &value) {
+        if(sizeWidth_ == sizeof(size_t)) {
+            ReadBytes(&value, sizeof(size_t));
+        }
+        else if(sizeWidth_ == 8) {
+            unsigned long long wide;
+            ReadBytes(&wide, 8);
+            value = (size_t)wide;
+
+            if(value != wide) {
+                // Too large for this platform.
+                value = 0;
+                failed_ = true;
+            }
+        }
+        else {
+            unsigned int narrow;
+            ReadBytes(&narrow, 4);
+            value = narrow;
+        }
+    }
+
+#ifdef _WIN32
+    void InitializeFile() {
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = NULL;
+    }
+
+    bool IsOpen() const {
+        return file_ != INVALID_HANDLE_VALUE;
+    }
+
+    bool OpenRead(wchar_t *path) {
+        file_ = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, 
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file_ == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file_, &size)) return false;
+        if((unsigned long long)size.QuadPart > (size_t)-1) return false;
+
+        size_ = (size_t)size.QuadPart;
+        if(size_ == 0) return true; // Empty files can't be mapped.
+
+        mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping_ == NULL) return false;
+
+        view_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        return view_ != NULL;
+    }
+
+    bool OpenWrite(wchar_t *path) {
+        file_ = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, 
+                           CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file_ == INVALID_HANDLE_VALUE) return false;
+
+        buffer_ = new char[WRITE_BUFFER_SIZE];
+        return true;
+    }
+
+    void CloseFile() {
+        if(view_ != NULL) UnmapViewOfFile(view_);
+        if(mapping_ != NULL) CloseHandle(mapping_);
+        if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        InitializeFile();
+    }
+
+    bool WriteFileBytes(const void *data, size_t size) {
+        unsigned long written;
+        return WriteFile(file_, data, (unsigned long)size, &written, NULL) && 
+               (written == size);
+    }
+#else
+    void InitializeFile() {
+        file_ = -1;
+    }
+
+    bool IsOpen() const {
+        return file_ != -1;
+    }
+
+    static bool NarrowPath(wchar_t *path, char *narrowPath, size_t size) {
+        // The path is converted using the current locale.
+        size_t length = wcstombs(narrowPath, path, size);
+        return (length != (size_t)-1) && (length < size);
+    }
+
+    bool OpenRead(wchar_t *path) {
+        char narrowPath[4096];
+        if(!NarrowPath(path, narrowPath, sizeof(narrowPath))) return false;
+
+        file_ = open(narrowPath, O_RDONLY);
+        if(file_ == -1) return false;
+
+        struct stat info;
+        if(fstat(file_, &info) != 0) return false;
+
+        size_ = (size_t)info.st_size;
+        if(size_ == 0) return true; // Empty files can't be mapped.
+
+        void *view = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+        if(view == MAP_FAILED) return false;
+
+        // The file is read from the start to the end.
+        madvise(view, size_, MADV_SEQUENTIAL);
+        view_ = (const char *)view;
+        return true;
+    }
+
+    bool OpenWrite(wchar_t *path) {
+        char narrowPath[4096];
+        if(!NarrowPath(path, narrowPath, sizeof(narrowPath))) return false;
+
+        file_ = open(narrowPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(file_ == -1) return false;
+
+        buffer_ = new char[WRITE_BUFFER_SIZE];
+        return true;
+    }
+
+    void CloseFile() {
+        if(view_ != NULL) munmap((void *)view_, size_);
+        if(file_ != -1) close(file_);
+        InitializeFile();
+    }
+
+    bool WriteFileBytes(const void *data, size_t size) {
+        const char *bytes = (const char *)data;
+
+        while(size > 0) {
+            ssize_t written = write(file_, bytes, size);
+
+            if(written < 0) {
+                if(errno == EINTR) continue;
+                return false;
+            }
+
+            bytes += written;
+            size -= (size_t)written;
+        }
+
+        return true;
+    }
+#endif
+};
+
+// The specializations for the basic types must be declared outside the class
+// (an explicit specialization inside a class is accepted only by Visual C++).
+template <>
+struct Stream::Helper<char> {
+    static void Write(const char &value, Stream &stream) { stream.WriteChar(value); }
+    static void Read(char &value, Stream &stream) { stream.ReadChar(value); }
+};
+
+template <>
+struct Stream::Helper<wchar_t> {
+    static void Write(const wchar_t &value, Stream &stream) { stream.WriteWChar(value); }
+    static void Read(wchar_t &value, Stream &stream) { stream.ReadWChar(value); }
+};
+
+template <>
+struct Stream::Helper<short int> {
+    static void Write(const short int &value, Stream &stream) { stream.WriteShort(value); }
+    static void Read(short int &value, Stream &stream) { stream.ReadShort(value); }
+};
+
+template <>
+struct Stream::Helper<int> {
+    static void Write(const int &value, Stream &stream) { stream.WriteInt(value); }
+    static void Read(int &value, Stream &stream) { stream.ReadInt(value); }
+};
+
+template <>
+struct Stream::Helper<float> {
+    static void Write(const float &value, Stream &stream) { stream.WriteFloat(value); }
+    static void Read(float &value, Stream &stream) { stream.ReadFloat(value); } 
+};
+
+template <>
+struct Stream::Helper<double> {
+    static void Write(const double &value, Stream &stream) { stream.WriteDouble(value); }
+    static void Read(double &value, Stream &stream) { stream.ReadDouble(value); }
+};
+
+template <>
+struct Stream::Helper<size_t> {
+    static void Write(const size_t &value, Stream &stream) { stream.WriteSizeT(value); }
+    static void Read(size_t &value, Stream &stream) { stream.ReadSizeT(value); }
+};
+
+template <>
+struct Stream::Helper<bool> {
+    static void Write(const bool &value, Stream &stream) { stream.WriteBool(value); }
+    static void Read(bool &value, Stream &stream) { stream.ReadBool(value); }
+};
+
+template <> struct Stream::ArrayHelper<char>      : Stream::BlockArrayHelper<char> {};
+template <> struct Stream::ArrayHelper<wchar_t>   : Stream::BlockArrayHelper<wchar_t> {};
+template <> struct Stream::ArrayHelper<short int> : Stream::BlockArrayHelper<short int> {};
+template <> struct Stream::ArrayHelper<int>       : Stream::BlockArrayHelper<int> {};
+template <> struct Stream::ArrayHelper<float>     : Stream::BlockArrayHelper<float> {};
+template <> struct Stream::ArrayHelper<double>    : Stream::BlockArrayHelper<double> {};
+template <> struct Stream::ArrayHelper<bool>      : Stream::BlockArrayHelper<bool> {};
+
+// The stored size of a size_t can differ from the one in memory.
+template <>
+struct Stream::ArrayHelper<size_t> {
+    static void Write(const size_t *items, size_t count, Stream &stream) {
+        if(stream.SizeWidth() == sizeof(size_t)) {
+            BlockArrayHelper<size_t>::Write(items, count, stream);
+        }
+        else {
+            for(size_t i = 0; i < count; i++) stream.WriteSizeT(items[i]);
+        }
+    }
+
+    static void Read(size_t *items, size_t count, Stream &stream) {
+        if(stream.SizeWidth() == sizeof(size_t)) {
+            BlockArrayHelper<size_t>::Read(items, count, stream);
+        }
+        else {
+            for(size_t i = 0; i < count; i++) stream.ReadSizeT(items[i]);
+        }
     }
 };
 
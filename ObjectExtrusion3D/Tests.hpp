@@ -38,10 +38,23 @@
 #include "Stream.hpp"
 #include "Shape.hpp"
 #include "BasicShapes.hpp"
+#include "BezierShape.hpp"
 #include "TranslateAction.hpp"
 #include "ScaleAction.hpp"
+#include "RotateAction.hpp"
 #include "IAction.hpp"
 #include "Storyboard.hpp"
+#include "FrameStore.hpp"
+#include "Transform.hpp"
+#include "TransformKernel.hpp"
+#include "PointBuffer.hpp"
+#include "ThreadPool.hpp"
+#include "MeshBuilder.hpp"
+#include "StlExporter.hpp"
+#include "MeshExporter.hpp"
+#include "BatchProcessor.hpp"
+#include "FrameCodec.hpp"
+#include "Scene.hpp"
 #include <cassert>
 
 void TestPoint() {
@@ -56,7 +69,7 @@ void TestPoint() {
     assert(b.Z == 3);
 
     Point c;
-    assert(c.X == 0 & &c.Y == 0 & &c.Z == 0);
+    assert(c.X == 0 && c.Y == 0 && c.Z == 0);
     c = a;
     assert(c.X == 1);
     assert(c.Y == 2);
@@ -99,6 +112,77 @@ void TestList() {
     assert(a[2] == 5);
 }
 
+void TestListMove() {
+    // Point has a vtable, so it's copied item by item.
+    List<Point> a;
+    for(int i = 0; i < 20; i++) {
+        a.Add(Point(i, 2 * i, 3 * i));
+    }
+
+    List<Point> b(a);
+    assert(b.Count() == 20);
+    assert(b[19] == Point(19, 38, 57));
+
+    // Moving transfers the array and leaves the source empty but usable.
+    Point *data = a.Data();
+    List<Point> c(std::move(a));
+    assert(c.Data() == data);
+    assert(c.Count() == 20);
+    assert(a.Count() == 0);
+    a.Add(Point(1, 1, 1));
+    assert(a.Count() == 1);
+
+    b = std::move(c);
+    assert(b.Data() == data);
+    assert(c.Count() == 0);
+
+    // A moved-from list can be added and copied like an empty one.
+    List<Point> e(b);
+    e.Add(c);
+    assert(e.Count() == 20);
+    List<Point> f(c);
+    assert(f.Count() == 0);
+    f = c;
+    assert(f.Count() == 0);
+
+    // Assignment returns the list, so it can be chained.
+    List<Point> d;
+    c = d = b;
+    assert((c.Count() == 20) && (d.Count() == 20));
+    assert(c.Data() != b.Data());
+    List<Point> &same = c;
+    c = same;
+    assert(c[5] == Point(5, 10, 15));
+
+    c.Swap(a);
+    assert((c.Count() == 1) && (a.Count() == 20));
+    assert(c[0] == Point(1, 1, 1));
+
+    // Inserting and removing move the other points correctly.
+    a.Insert(Point(-1, -1, -1), 3);
+    assert(a[3] == Point(-1, -1, -1));
+    assert(a[4] == Point(3, 6, 9));
+    a.Remove(3);
+    a.Remove(0);
+    assert(a.Count() == 19);
+    assert(a[0] == Point(1, 2, 3));
+    assert(a[18] == Point(19, 38, 57));
+
+    // Reserving keeps the points and avoids growing while adding.
+    a.Reserve(100);
+    assert(a.Capacity() == 100);
+    data = a.Data();
+
+    for(int i = 0; i < 81; i++) {
+        a.Add(Point());
+    }
+
+    assert(a.Data() == data);
+    assert(a[18] == Point(19, 38, 57));
+    a.Reserve(10);
+    assert(a.Capacity() == 100);
+}
+
 void TestSerialization() {
     Stream stream(L"test.dat", true);
     List<int> l;
@@ -146,7 +230,7 @@ void TestStoryboard() {
     sb.Actions().Add(a);
     sb.Actions().Add(b);
     sb.Actions().Add(c);
-    sb.SetShapeObject(shape);
+    sb.SetShapeObject(&shape);
 
     assert(sb.TotalSteps() == 10);
     assert(sb.CurrentAction() == NULL);
@@ -155,6 +239,1325 @@ void TestStoryboard() {
     for(size_t i = 0; i < sb.TotalSteps(); i++) {
         sb.NextStep();
     }
+
+    // The linked action doesn't add frames of its own.
+    assert(sb.Frames().Count() == 8);
+    assert(sb.Frames()[7][0] == Point(10, 10, 10));
+    assert(sb.Frames()[7][3] == Point(13, 13, 13));
+
+    // Playing again must reuse the frame memory.
+    Point *slab = sb.Frames()[0].Data();
+    sb.Reset();
+    sb.Play();
+    assert(sb.Frames().Count() == 1);
+    assert(sb.Frames()[0].Data() == slab);
+}
+
+void TestFrameStore() {
+    FrameStore store;
+    store.Reserve(2, 3);
+    assert(store.FrameCapacity() == 2);
+
+    Frame a = store.AddFrame();
+    a[0] = Point(1, 2, 3);
+    Frame b = store.AddFrame();
+    b.CopyFrom(a);
+    assert(store.Count() == 2);
+    assert(b[0] == Point(1, 2, 3));
+    assert(b.Data() == a.Data() + 3);
+
+    // Adding more frames than reserved grows the slab.
+    store.AddFrame();
+    assert(store.Count() == 3);
+    assert(store[1][0] == Point(1, 2, 3));
+
+    store.Clear();
+    assert(store.Count() == 0);
+}
+
+void TestEvaluateAt() {
+    Shape *shape = ShapeGenerator::Circle(50, 16, false);
+    IAction* a = new RotateAction(1.5, ROTATION_CENTER, AXIS_Y);
+    IAction* b = new TranslateAction(0, 0, 90);
+    IAction* c = new ScaleAction(20, 10, 5);
+    IAction* d = new RotateAction(2, ROTATION_LEFT, AXIS_X);
+    a->SetSteps(30);
+    b->SetSteps(30);
+    c->SetSteps(10);
+    d->SetSteps(20);
+    b->SetWithPrevious(true);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.Actions().Add(c);
+    sb.Actions().Add(d);
+    sb.SetShapeObject(shape);
+
+    sb.Play();
+    while(sb.NextStep()) {}
+    assert(sb.FrameCount() == 61);
+    assert(sb.Frames().Count() == 61);
+
+    // Each frame computed directly must match the played one.
+    List<Point> points;
+
+    for(int i = sb.FrameCount() - 1; i >= 0; i--) {
+        sb.EvaluateAt(i, points);
+        Frame frame = sb.Frames()[i];
+        assert(points.Count() == frame.Count());
+
+        for(size_t j = 0; j < points.Count(); j++) {
+            assert(points[j] == frame[j]);
+        }
+    }
+
+    PointBuffer buffer;
+    sb.EvaluateAt(60, buffer);
+    assert(buffer.Count() == 17);
+    assert(buffer.Get(3) == sb.Frames()[60][3]);
+
+    // Editing the shape or the actions directly is noticed.
+    shape->Points()[1].X += 4;
+    sb.EvaluateAt(0, points);
+    assert(points[1].X == shape->Points()[1].X);
+    assert(sb.Frames().Count() == 0);
+
+    sb.Actions().Remove(d);
+    delete d;
+    assert(sb.FrameCount() == 41);
+    delete shape;
+}
+
+void TestActions() {
+    // Quarter turn around Z, linked with a translation and
+    // followed by a scale which should add 20 to the radius.
+    List<Point> points;
+    points.Add(Point(50, 0, 0));
+    points.Add(Point(0, 50, 0));
+    points.Add(Point(-50, 0, 0));
+    points.Add(Point(0, -50, 0));
+
+    Shape shape(points);
+    IAction* a = new RotateAction(M_PI / 2, ROTATION_ZERO, AXIS_Z);
+    IAction* b = new TranslateAction(0, 0, 30);
+    IAction* c = new ScaleAction(20, 20, 20);
+    a->SetSteps(10);
+    b->SetSteps(10);
+    c->SetSteps(4);
+    b->SetWithPrevious(true);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.Actions().Add(c);
+    sb.SetShapeObject(&shape);
+
+    sb.Play();
+    while(sb.NextStep()) {}
+    assert(sb.Frames().Count() == 15);
+    assert(sb.CurrentAction() == c);
+
+    Frame rotated = sb.Frames()[10];
+    assert(rotated[0] == Point(0, 50, 30));
+    assert(rotated[1] == Point(-50, 0, 30));
+
+    Frame scaled = sb.Frames()[14];
+    assert(scaled[0] == Point(0, 70, 30));
+    assert(scaled[1] == Point(-70, 0, 30));
+}
+
+void TestTransformKernel() {
+    const size_t COUNT = 1003; // Not a multiple of the vector width.
+    double x[COUNT], y[COUNT], z[COUNT];
+    double outX[COUNT], outY[COUNT], outZ[COUNT];
+
+    for(size_t i = 0; i < COUNT; i++) {
+        x[i] = (double)i;
+        y[i] = (double)(i % 7) - 3;
+        z[i] = (double)(i % 13) * 0.5;
+    }
+
+    Transform t = Transform::Translation(3, -2, 1) * 
+                  Transform::RotationY(0.3, Point(1, 2, 3)) *
+                  Transform::Scaling(2, 1, 0.5);
+    KernelLevel supported = TransformKernel::SupportedLevel();
+
+    for(int level = KERNEL_SCALAR; level <= supported; level++) {
+        TransformKernel::SetLevel((KernelLevel)level);
+        TransformKernel::Apply(t, x, y, z, outX, outY, outZ, COUNT);
+
+        for(size_t i = 0; i < COUNT; i++) {
+            Point expected = t.Apply(Point(x[i], y[i], z[i]));
+            assert(expected == Point(outX[i], outY[i], outZ[i]));
+        }
+    }
+
+    TransformKernel::SetLevel(supported);
+}
+
+void TestPointBuffer() {
+    List<Point> points;
+    for(int i = 0; i < 20; i++) {
+        points.Add(Point(i, 2 * i, 3 * i));
+    }
+
+    PointBuffer buffer(points);
+    assert(buffer.Count() == 20);
+    assert(((size_t)buffer.X() % 32) == 0);
+    assert(((size_t)buffer.Y() % 32) == 0);
+    assert(((size_t)buffer.Z() % 32) == 0);
+    assert(buffer.Get(5) == Point(5, 10, 15));
+
+    // Transforming the buffer matches transforming the points.
+    Transform t = Transform::RotationZ(0.7, Point(1, 1, 0));
+    buffer.Apply(t);
+
+    PointBufferF floats;
+    floats.CopyFrom(points);
+    floats.Apply(t);
+
+    List<Point> result;
+    buffer.CopyTo(result);
+    assert(result.Count() == 20);
+
+    for(size_t i = 0; i < points.Count(); i++) {
+        assert(result[i] == t.Apply(points[i]));
+        assert(floats.Get(i).Distance(result[i]) < 0.001);
+    }
+
+    // Executing an action on the buffer.
+    TranslateAction action(10, 0, 0);
+    action.SetSteps(2);
+    action.Execute(0, buffer);
+    assert(buffer.Get(0) == Point(result[0].X + 5, result[0].Y, result[0].Z));
+}
+
+void TestParallelFrames() {
+    Shape *shape = ShapeGenerator::Circle(50, 500, false);
+    IAction* a = new RotateAction(2 * M_PI, ROTATION_LEFT, AXIS_Y);
+    IAction* b = new TranslateAction(0, 100, 0);
+    IAction* c = new ScaleAction(30, 30, 0);
+    a->SetSteps(200);
+    b->SetSteps(200);
+    c->SetSteps(50);
+    b->SetWithPrevious(true);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.Actions().Add(c);
+    sb.SetShapeObject(shape);
+
+    List<Point> serial;
+    sb.Play();
+    while(sb.NextStep()) {}
+
+    for(size_t i = 0; i < sb.Frames().Count(); i++) {
+        serial.Add(sb.Frames()[i].Data(), sb.Frames().PointCount());
+    }
+
+    // The parallel frames must be identical, not only close.
+    ThreadPool pool(4);
+    assert(pool.ThreadCount() == 4);
+    sb.Reset();
+    sb.GenerateFrames(&pool);
+    assert(sb.Frames().Count() == 251);
+    assert(sb.CurrentAction() == c);
+
+    for(size_t i = 0; i < sb.Frames().Count(); i++) {
+        Frame frame = sb.Frames()[i];
+
+        for(size_t j = 0; j < frame.Count(); j++) {
+            const Point &point = serial[i * frame.Count() + j];
+            assert((frame[j].X == point.X) && (frame[j].Y == point.Y) && 
+                   (frame[j].Z == point.Z));
+        }
+    }
+
+    delete shape;
+}
+
+void TestChunkedExecute() {
+    // Large enough to be split into chunks.
+    const size_t POINTS = Transform::PARALLEL_THRESHOLD * 2 + 123;
+    Shape *shape = ShapeGenerator::Circle(50, POINTS);
+    IAction* action = new RotateAction(M_PI / 3, ROTATION_LEFT, AXIS_X);
+    action->SetSteps(10);
+
+    List<Point> serial(shape->Points());
+    List<Point> chunked(shape->Points());
+    action->Initialize(Frame(serial));
+
+    ThreadPool pool(4);
+    Frame serialPoints(serial);
+    Frame chunkedPoints(chunked);
+
+    for(int step = 0; step < action->Steps(); step++) {
+        action->Execute(step, serialPoints);
+        action->Execute(step, chunkedPoints, &pool);
+    }
+
+    for(size_t i = 0; i < POINTS; i++) {
+        assert((serial[i].X == chunked[i].X) && (serial[i].Y == chunked[i].Y) &&
+               (serial[i].Z == chunked[i].Z));
+    }
+
+    delete action;
+    delete shape;
+}
+
+// The original radial scale, which moves each point away from the centroid
+// by computing its spherical coordinates.
+void ReferenceScale(List<Point> &points, double stepX, double stepY, double stepZ) {
+    Point centroid = Point::Centroid(points);
+    double minDistance = std::numeric_limits<double>::max();
+
+    for(size_t i = 0; i < points.Count(); i++) {
+        minDistance = std::min(minDistance, points[i].Distance(centroid));
+    }
+
+    for(size_t i = 0; i < points.Count(); i++) {
+        Point &point = points[i];
+        double distance = point.Distance(centroid);
+        double angle1 = atan2(point.Y - centroid.Y, point.X - centroid.X);
+        double angle2 = acos((point.Z - centroid.Z) / distance);
+        double scale = distance / minDistance;
+
+        point.X = centroid.X + ((distance + stepX * scale) * cos(angle1) * sin(angle2));
+        point.Y = centroid.Y + ((distance + stepY * scale) * sin(angle1) * sin(angle2));
+        point.Z = centroid.Z + ((distance + stepZ * scale) * cos(angle2));
+    }
+}
+
+void TestScaleEquivalence() {
+    // A uniform scale linked with a rotation, followed by a non-uniform one.
+    List<Point> points;
+
+    for(int i = 0; i < 100; i++) {
+        points.Add(Point(40 * cos(i * 0.3) + 5, 30 * sin(i * 0.7) - 8, 20 * sin(i * 0.2)));
+    }
+
+    Shape shape(points);
+    IAction* a = new ScaleAction(25, 25, 25);
+    IAction* b = new RotateAction(M_PI / 2, ROTATION_ZERO, AXIS_Y);
+    IAction* c = new ScaleAction(10, -5, 15);
+    a->SetSteps(8);
+    b->SetSteps(8);
+    c->SetSteps(6);
+    b->SetWithPrevious(true);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.Actions().Add(c);
+    sb.SetShapeObject(&shape);
+
+    sb.Play();
+    while(sb.NextStep()) {}
+    assert(sb.Frames().Count() == 15);
+
+    Transform rotation = Transform::RotationY(M_PI / 2 / 8);
+    List<Point> expected(points);
+    
+    for(int frame = 1; frame < 15; frame++) {
+        if(frame <= 8) {
+            ReferenceScale(expected, 25.0 / 8, 25.0 / 8, 25.0 / 8);
+            Frame expectedPoints(expected);
+            rotation.Apply(expectedPoints);
+        }
+        else ReferenceScale(expected, 10.0 / 6, -5.0 / 6, 15.0 / 6);
+
+        Frame actual = sb.Frames()[frame];
+
+        for(size_t i = 0; i < expected.Count(); i++) {
+            assert(actual[i].Distance(expected[i]) < 1e-9 * expected[i].Distance(Point()));
+        }
+    }
+}
+
+void AssertSameFrames(FrameStore &a, FrameStore &b) {
+    assert(a.Count() == b.Count());
+
+    for(size_t i = 0; i < a.Count(); i++) {
+        Frame frameA = a[i];
+        Frame frameB = b[i];
+
+        for(size_t j = 0; j < frameA.Count(); j++) {
+            assert((frameA[j].X == frameB[j].X) && (frameA[j].Y == frameB[j].Y) && 
+                   (frameA[j].Z == frameB[j].Z));
+        }
+    }
+}
+
+void TestActionChanged() {
+    Shape *shape = ShapeGenerator::Circle(50, 40, false);
+    TranslateAction* a = new TranslateAction(0, 100, 0);
+    RotateAction* b = new RotateAction(M_PI, ROTATION_LEFT, AXIS_Y);
+    ScaleAction* c = new ScaleAction(30, 10, 0);
+    TranslateAction* d = new TranslateAction(20, 0, 0);
+    a->SetSteps(10);
+    b->SetSteps(20);
+    c->SetSteps(5);
+    d->SetSteps(5);
+    c->SetWithPrevious(true);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.Actions().Add(c);
+    sb.Actions().Add(d);
+    sb.SetShapeObject(shape);
+    sb.GenerateFrames();
+    assert(sb.FrameCount() == 36);
+
+    // Change a linked action; the frames must be
+    // the same as after playing from the start.
+    c->SetScaleY(-20);
+    sb.ActionChanged(c);
+
+    Storyboard expected;
+    expected.Actions().Add(new TranslateAction(0, 100, 0));
+    expected.Actions().Add(new RotateAction(M_PI, ROTATION_LEFT, AXIS_Y));
+    expected.Actions().Add(new ScaleAction(30, -20, 0));
+    expected.Actions().Add(new TranslateAction(20, 0, 0));
+    expected.Actions()[0]->SetSteps(10);
+    expected.Actions()[1]->SetSteps(20);
+    expected.Actions()[2]->SetSteps(5);
+    expected.Actions()[3]->SetSteps(5);
+    expected.Actions()[2]->SetWithPrevious(true);
+    expected.SetShapeObject(shape);
+    expected.GenerateFrames();
+    AssertSameFrames(sb.Frames(), expected.Frames());
+
+    // Link the last action and change its steps.
+    d->SetWithPrevious(true);
+    d->SetSteps(30);
+    sb.ActionChanged(d);
+    assert(sb.FrameCount() == 31);
+    assert(sb.CurrentAction() == b);
+
+    expected.Actions()[3]->SetWithPrevious(true);
+    expected.Actions()[3]->SetSteps(30);
+    expected.Reset();
+    expected.GenerateFrames();
+    AssertSameFrames(sb.Frames(), expected.Frames());
+
+    // While playing, only the frames generated so far are recomputed.
+    sb.Play();
+    expected.Play();
+
+    for(int i = 0; i < 15; i++) {
+        sb.NextStep();
+        expected.NextStep();
+    }
+
+    a->SetDeltaY(50);
+    sb.ActionChanged(a);
+    assert(sb.Frames().Count() == 16);
+
+    ((TranslateAction *)expected.Actions()[0])->SetDeltaY(50);
+    expected.Play();
+
+    for(int i = 0; i < 15; i++) {
+        expected.NextStep();
+    }
+
+    AssertSameFrames(sb.Frames(), expected.Frames());
+
+    // Removing an action, then changing another one after playing ended.
+    Storyboard moved;
+    TranslateAction *x = new TranslateAction(10, 0, 0);
+    TranslateAction *y = new TranslateAction(0, 10, 0);
+    TranslateAction *z = new TranslateAction(0, 0, 10);
+    moved.Actions().Add(x);
+    moved.Actions().Add(y);
+    moved.Actions().Add(z);
+    moved.SetShapeObject(shape);
+    moved.GenerateFrames();
+
+    moved.Actions().Remove(x);
+    delete x;
+    z->SetDeltaZ(20);
+    assert(moved.ActionChanged(z) == 0);
+    assert(moved.IsGenerated());
+
+    Storyboard remaining;
+    remaining.Actions().Add(new TranslateAction(0, 10, 0));
+    remaining.Actions().Add(new TranslateAction(0, 0, 20));
+    remaining.SetShapeObject(shape);
+    remaining.GenerateFrames();
+    AssertSameFrames(moved.Frames(), remaining.Frames());
+    delete shape;
+}
+
+void AssertSamePoints(const List<Point> &a, const List<Point> &b) {
+    assert(a.Count() == b.Count());
+
+    for(size_t i = 0; i < a.Count(); i++) {
+        assert((a[i].X == b[i].X) && (a[i].Y == b[i].Y) && (a[i].Z == b[i].Z));
+    }
+}
+
+void TestBezierCache() {
+    List<Point> anchors;
+    List<Point> controls;
+
+    for(int i = 0; i < 20; i++) {
+        anchors.Add(Point(i * 10, i % 3));
+        controls.Add(Point(i * 10 + 3, 5));
+        controls.Add(Point(i * 10 + 7, -5));
+    }
+
+    BezierShape shape(anchors, controls);
+    assert(shape.Points().Count() == 19 * 10);
+
+    // Move a control point, like when dragging it.
+    shape.ControlPoints()[7].Y += 0.001;
+    controls[7].Y += 0.001;
+    AssertSamePoints(shape.Points(), BezierShape(anchors, controls).Points());
+
+    // Add and remove segments.
+    anchors.Add(Point(300, 1));
+    shape.AnchorPoints().Add(Point(300, 1));
+    AssertSamePoints(shape.Points(), BezierShape(anchors, controls).Points());
+
+    shape.AnchorPoints().Remove((size_t)0);
+    shape.ControlPoints().Remove((size_t)0);
+    shape.ControlPoints().Remove((size_t)0);
+    anchors.Remove((size_t)0);
+    controls.Remove((size_t)0);
+    controls.Remove((size_t)0);
+    AssertSamePoints(shape.Points(), BezierShape(anchors, controls).Points());
+
+    shape.Clear();
+    assert(shape.Points().Count() == 0);
+}
+
+void TestBezierEvaluation() {
+    Point anchor1(-120, 40), anchor2(300, -75);
+    Point control1(10, 400), control2(150, -350);
+    Point points[64];
+    BezierShape::EvaluateCurve(anchor1, anchor2, control1, control2, 64, points);
+
+    for(int i = 0; i < 64; i++) {
+        // Compare with the Bernstein form of the curve.
+        double u = i / 63.0;
+        double v = 1 - u;
+        double x = v*v*v*anchor1.X + 3*v*v*u*control1.X + 3*v*u*u*control2.X + u*u*u*anchor2.X;
+        double y = v*v*v*anchor1.Y + 3*v*v*u*control1.Y + 3*v*u*u*control2.Y + u*u*u*anchor2.Y;
+        assert((fabs(points[i].X - x) < 1e-9) && (fabs(points[i].Y - y) < 1e-9));
+        assert(points[i].Z == 0);
+    }
+}
+
+void TestBezierAdaptive() {
+    List<Point> anchors;
+    List<Point> controls;
+    anchors.Add(Point(0, 0));
+    anchors.Add(Point(100, 0));
+    anchors.Add(Point(120, 50));
+    controls.Add(Point(30, 0));   // A straight segment...
+    controls.Add(Point(70, 0));
+    controls.Add(Point(200, -80)); // ...followed by a tight curve.
+    controls.Add(Point(40, 120));
+
+    BezierShape shape(anchors, controls);
+    shape.SetTolerance(0.05);
+    List<Point> &points = shape.Points();
+    assert((points[0] == Point(0, 0)) && (points[1] == Point(100, 0)));
+    assert(points[points.Count() - 1] == Point(120, 50));
+
+    // Each point of the curve must be close to the lines.
+    Point curve[2001];
+    BezierShape::EvaluateCurve(anchors[1], anchors[2], controls[2], controls[3], 2001, curve);
+
+    for(int i = 0; i < 2001; i++) {
+        double distance = std::numeric_limits<double>::max();
+
+        for(size_t j = 3; j < points.Count(); j++) {
+            Point a = points[j - 1];
+            Point b = points[j];
+            double dx = b.X - a.X;
+            double dy = b.Y - a.Y;
+            double t = ((curve[i].X - a.X) * dx + (curve[i].Y - a.Y) * dy) / (dx * dx + dy * dy);
+            t = std::max(0.0, std::min(1.0, t));
+            distance = std::min(distance, curve[i].Distance(Point(a.X + t * dx, a.Y + t * dy)));
+        }
+
+        assert(distance <= 0.05 + 1e-9);
+    }
+
+    // A smaller tolerance needs more points.
+    size_t count = points.Count();
+    shape.SetTolerance(0.005);
+    assert(shape.Points().Count() > count);
+
+    // Changing the shape must give the same points as tessellating it again.
+    shape.ControlPoints()[3].X += 50;
+    controls[3].X += 50;
+    BezierShape expected(anchors, controls);
+    expected.SetTolerance(0.005);
+    AssertSamePoints(shape.Points(), expected.Points());
+
+    shape.ControlPoints()[1].Y += 10;
+    controls[1].Y += 10;
+    BezierShape expected2(anchors, controls);
+    expected2.SetTolerance(0.005);
+    AssertSamePoints(shape.Points(), expected2.Points());
+}
+
+void TestMeshBuilder() {
+    // A tube made by translating a circle (17 points) along Z.
+    Shape *shape = ShapeGenerator::Circle(10, 16, false);
+    IAction* action = new TranslateAction(0, 0, 30);
+    action->SetSteps(3);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+    sb.Play();
+    sb.NextStep();
+
+    MeshBuilder builder;
+    builder.Update(sb.Frames());
+    assert(builder.FrameCount() == 2);
+    assert(builder.MeshObject().TriangleCount() == 16 * 2);
+
+    // Frames are appended as they are generated.
+    while(sb.NextStep()) {
+        builder.Update(sb.Frames());
+    }
+
+    Mesh &mesh = builder.MeshObject();
+    assert(mesh.VertexCount() == 4 * 17);
+    assert(mesh.TriangleCount() == 3 * 16 * 2);
+    assert(mesh.Indices()[0] == 0);
+    assert(mesh.Indices()[1] == 18);
+    assert(mesh.Indices()[2] == 17);
+
+    for(size_t i = 0; i < mesh.VertexCount(); i++) {
+        // The normals of the tube are perpendicular to its axis.
+        const Point &normal = mesh.Normals()[i];
+        assert(fabs(normal.Magnitutde() - 1) < 1e-9);
+        assert(fabs(normal.Z) < 1e-9);
+        assert(mesh.Vertices()[i] == sb.Frames()[i / 17][i % 17]);
+    }
+
+    // Removing frames and adding them again gives the same mesh.
+    builder.RemoveFrames(2);
+    assert(mesh.TriangleCount() == 16 * 2);
+    builder.Update(sb.Frames());
+
+    MeshBuilder expected;
+    expected.Update(sb.Frames());
+    AssertSamePoints(mesh.Vertices(), expected.MeshObject().Vertices());
+    AssertSamePoints(mesh.Normals(), expected.MeshObject().Normals());
+    assert(mesh.Indices().Count() == expected.MeshObject().Indices().Count());
+
+    for(size_t i = 0; i < mesh.Indices().Count(); i++) {
+        assert(mesh.Indices()[i] == expected.MeshObject().Indices()[i]);
+    }
+
+    delete shape;
+}
+
+void TestMeshNormals() {
+    // The smooth normals of a tube point away from its axis.
+    Shape *shape = ShapeGenerator::Circle(10, 64, false);
+    IAction* action = new TranslateAction(0, 0, 50);
+    action->SetSteps(5);
+
+    Storyboard sb;
+    sb.Actions().Add(action);
+    sb.SetShapeObject(shape);
+    sb.GenerateFrames();
+
+    MeshBuilder builder;
+    builder.Update(sb.Frames());
+    Mesh &mesh = builder.MeshObject();
+
+    for(size_t i = 0; i < mesh.VertexCount(); i++) {
+        const Point &vertex = mesh.Vertices()[i];
+        const Point &normal = mesh.Normals()[i];
+        double dot = (vertex.X * normal.X + vertex.Y * normal.Y) / 10;
+        assert(fabs(normal.Magnitutde() - 1) < 1e-9);
+
+        // The points at the seam of the circle have triangles only on one side,
+        // and the ones in the first and last frame have more triangles on one side.
+        if((i % 65 != 0) && (i % 65 != 64)) {
+            bool inside = (i >= 65) && (i < mesh.VertexCount() - 65);
+            assert(fabs(dot - 1) < (inside ? 1e-9 : 1e-3));
+        }
+    }
+
+    // Changing a frame must give the same mesh as building it again.
+    Frame frame = sb.Frames()[3];
+
+    for(size_t i = 0; i < frame.Count(); i++) {
+        frame[i].X *= 1.5;
+    }
+
+    builder.FrameChanged(3, frame);
+    MeshBuilder expected;
+    expected.Update(sb.Frames());
+    AssertSamePoints(mesh.Vertices(), expected.MeshObject().Vertices());
+    AssertSamePoints(mesh.Normals(), expected.MeshObject().Normals());
+    delete shape;
+}
+
+void TestStlExport() {
+    Shape *shape = ShapeGenerator::Circle(10, 16, false);
+    IAction* a = new TranslateAction(0, 0, 30);
+    IAction* b = new ScaleAction(5, 5, 0);
+    a->SetSteps(6);
+    b->SetSteps(4);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.Actions().Add(b);
+    sb.SetShapeObject(shape);
+
+    StlExporter exporter;
+    assert(exporter.Save(sb, L"test.stl"));
+    assert(exporter.TriangleCount() == 10 * 16 * 2);
+
+    // The file must contain the triangles of the mesh.
+    sb.GenerateFrames();
+    MeshBuilder builder;
+    builder.Update(sb.Frames());
+    Mesh &mesh = builder.MeshObject();
+
+    Stream stream(L"test.stl");
+    char header[80];
+    int triangles;
+    stream.ReadBlock(header, 80);
+    stream.ReadInt(triangles);
+    assert(triangles == (int)mesh.TriangleCount());
+
+    for(int i = 0; i < triangles; i++) {
+        float values[12];
+        short attribute;
+        stream.ReadBlock(values, sizeof(values));
+        stream.ReadShort(attribute);
+
+        for(int j = 0; j < 3; j++) {
+            const Point &vertex = mesh.Vertices()[mesh.Indices()[i * 3 + j]];
+            assert(values[3 + j * 3] == (float)vertex.X);
+            assert(values[4 + j * 3] == (float)vertex.Y);
+            assert(values[5 + j * 3] == (float)vertex.Z);
+        }
+    }
+
+    delete shape;
+}
+
+void TestMeshExport() {
+    // The first and last points of the circle are the same.
+    Shape *shape = ShapeGenerator::Circle(10, 16, false);
+    IAction* a = new TranslateAction(0, 0, 30);
+    a->SetSteps(10);
+
+    Storyboard sb;
+    sb.Actions().Add(a);
+    sb.SetShapeObject(shape);
+    sb.GenerateFrames();
+
+    MeshBuilder builder;
+    builder.Update(sb.Frames());
+    Mesh &mesh = builder.MeshObject();
+    assert(mesh.VertexCount() == 11 * 17);
+
+    ObjExporter obj;
+    assert(obj.Save(mesh, L"test.obj"));
+    assert(obj.VertexCount() == 11 * 16);
+    assert(obj.NormalCount() <= mesh.VertexCount());
+
+    PlyExporter ply;
+    assert(ply.Save(mesh, L"test.ply"));
+    assert(ply.VertexCount() <= mesh.VertexCount());
+
+    // Read the PLY file back and compare the faces with the mesh.
+    Stream stream(L"test.ply");
+    char line[128];
+    size_t length = 0;
+    unsigned vertices = 0;
+    unsigned faces = 0;
+
+    while(true) {
+        stream.ReadBlock(&line[length], 1);
+
+        if(line[length] == '\n') {
+            line[length] = 0;
+            sscanf(line, "element vertex %u", &vertices);
+            sscanf(line, "element face %u", &faces);
+            if(strcmp(line, "end_header") == 0) break;
+            length = 0;
+        }
+        else length++;
+    }
+
+    assert(vertices == ply.VertexCount());
+    assert(faces == mesh.TriangleCount());
+    List<Point> points;
+
+    for(unsigned i = 0; i < vertices; i++) {
+        float values[6];
+        stream.ReadBlock(values, sizeof(values));
+        points.Add(Point(values[0], values[1], values[2]));
+    }
+
+    for(unsigned i = 0; i < faces; i++) {
+        unsigned char count;
+        unsigned int face[3];
+        stream.ReadBlock(&count, 1);
+        stream.ReadBlock(face, sizeof(face));
+        assert(count == 3);
+
+        for(int j = 0; j < 3; j++) {
+            const Point &vertex = mesh.Vertices()[mesh.Indices()[i * 3 + j]];
+            assert(points[face[j]].X == (float)vertex.X);
+            assert(points[face[j]].Y == (float)vertex.Y);
+            assert(points[face[j]].Z == (float)vertex.Z);
+        }
+    }
+
+    // Blocks larger than the buffer are written in order with the rest.
+    const size_t blockSize = (1 << 20) + 100;
+    char *block = new char[blockSize];
+    memset(block, 'b', blockSize);
+    Stream memory;
+
+    {
+        WriteBuffer buffer(memory);
+        buffer.WriteText("a");
+        buffer.Write(block, blockSize);
+        buffer.WriteText("c");
+    }
+
+    assert(memory.Size() == blockSize + 2);
+    assert((memory.Data()[0] == 'a') && (memory.Data()[blockSize + 1] == 'c'));
+    assert(memcmp(memory.Data() + 1, block, blockSize) == 0);
+    delete[] block;
+    delete shape;
+}
+
+void TestBatchProcessor() {
+    // Two scenes with a different number of points and frames.
+    Scene small;
+    small.SetShape(ShapeGenerator::Circle(10, 16, false));
+    IAction* a = new TranslateAction(0, 0, 30);
+    a->SetSteps(10);
+    small.Storyboard().Actions().Add(a);
+    assert(small.Save(L"test_small.scn"));
+
+    Scene large;
+    large.SetShape(ShapeGenerator::Circle(10, 64, false));
+    IAction* b = new ScaleAction(2, 2, 0);
+    b->SetSteps(20);
+    large.Storyboard().Actions().Add(b);
+    assert(large.Save(L"test_large.scn"));
+
+    // The contexts are reused between the scenes, in any order.
+    for(int threads = 0; threads <= 2; threads++) {
+        BatchProcessor batch(FORMAT_PLY);
+        batch.AddToDirectory("test_small.scn", "");
+        batch.AddToDirectory("test_large.scn", "");
+        batch.AddToDirectory("test_missing.scn", "");
+        batch.Add("test_small.scn", "test_small_copy.ply");
+        batch.AddToDirectory("test_small.scn", "");
+
+        if(threads == 0) {
+            batch.Run();
+        }
+        else {
+            ThreadPool pool(threads);
+            batch.Run(&pool);
+        }
+
+        assert(batch.Count() == 5);
+        assert(batch.FailedCount() == 2);
+        assert(batch.Result(0).Output == "test_small.ply");
+        assert(batch.Result(0).Error == NULL);
+        assert(batch.Result(0).Triangles == 10 * 16 * 2);
+        assert(batch.Result(1).Triangles == 20 * 64 * 2);
+        assert(batch.Result(2).Error != NULL);
+        assert(batch.Result(3).Triangles == 10 * 16 * 2);
+
+        // The same output as the first scene.
+        assert(batch.Result(4).Error != NULL);
+        assert(batch.Result(4).Triangles == 0);
+    }
+}
+
+void TestStreamBuffering() {
+    // Enough small values to fill the write buffer many times,
+    // followed by a block larger than the buffer.
+    const int VALUES = 100000;
+    const size_t BLOCK_SIZE = 200000;
+    char *block = new char[BLOCK_SIZE];
+
+    for(size_t i = 0; i < BLOCK_SIZE; i++) {
+        block[i] = (char)(i * 7);
+    }
+
+    Stream stream(L"test.dat", true);
+    assert(stream.IsValid());
+
+    for(int i = 0; i < VALUES; i++) {
+        stream.Write(i);
+        stream.Write(i * 0.5);
+    }
+
+    stream.WriteBlock(block, BLOCK_SIZE);
+    stream.Write((short)-1);
+    size_t size = VALUES * (sizeof(int) + sizeof(double)) + BLOCK_SIZE + sizeof(short);
+    assert(stream.Size() == size);
+    stream.Close();
+
+    stream.Open(L"test.dat");
+    assert(stream.IsValid());
+    assert(stream.Size() == size);
+
+    for(int i = 0; i < VALUES; i++) {
+        int a;
+        double b;
+        stream.Read(a);
+        stream.Read(b);
+        assert((a == i) && (b == i * 0.5));
+    }
+
+    char *readBlock = new char[BLOCK_SIZE];
+    stream.ReadBlock(readBlock, BLOCK_SIZE);
+    assert(memcmp(block, readBlock, BLOCK_SIZE) == 0);
+
+    short last;
+    stream.Read(last);
+    assert((last == -1) && !stream.Failed());
+
+    // Reading past the end gives zeros.
+    int extra = 5;
+    stream.Read(extra);
+    assert((extra == 0) && stream.Failed());
+    stream.Close();
+
+    // Empty and missing files.
+    stream.Open(L"test.dat", true);
+    stream.Close();
+    stream.Open(L"test.dat");
+    assert(stream.IsValid() && (stream.Size() == 0));
+    assert(!stream.Open(L"test_missing.dat"));
+
+    delete[] block;
+    delete[] readBlock;
+}
+
+void TestArraySerialization() {
+    // More points than a block of the point array writer.
+    List<Point> points;
+    List<int> numbers;
+
+    for(int i = 0; i < 2500; i++) {
+        points.Add(Point(i, -i * 0.5, i * 0.25));
+        numbers.Add(i * 3);
+    }
+
+    // Writing the arrays must give the same bytes as writing the items.
+    Stream stream(L"test.dat", true);
+    points.Serialize(stream);
+    numbers.Serialize(stream);
+    size_t size = stream.Size();
+    stream.Close();
+
+    stream.Open(L"test_items.dat", true);
+    stream.Write(points.Count());
+    for(size_t i = 0; i < points.Count(); i++) stream.Write(points[i]);
+    stream.Write(numbers.Count());
+    for(size_t i = 0; i < numbers.Count(); i++) stream.Write(numbers[i]);
+    assert(stream.Size() == size);
+    stream.Close();
+
+    char *bytes = new char[size];
+    char *itemBytes = new char[size];
+    stream.Open(L"test.dat");
+    stream.ReadBlock(bytes, size);
+    stream.Open(L"test_items.dat");
+    stream.ReadBlock(itemBytes, size);
+    assert(memcmp(bytes, itemBytes, size) == 0);
+
+    stream.Open(L"test.dat");
+    List<Point> readPoints;
+    List<int> readNumbers;
+    readPoints.Deserialize(stream);
+    readNumbers.Deserialize(stream);
+    assert(!stream.Failed());
+    assert(readPoints.Count() == points.Count());
+    assert(readNumbers.Count() == numbers.Count());
+
+    for(size_t i = 0; i < points.Count(); i++) {
+        assert(readPoints[i] == points[i]);
+        assert(readNumbers[i] == numbers[i]);
+    }
+
+    delete[] bytes;
+    delete[] itemBytes;
+}
+
+// Compares the frames generated by the storyboards of two scenes.
+void AssertSameScene(Scene &a, Scene &b) {
+    assert(a.ShapeObject()->Type() == b.ShapeObject()->Type());
+    assert(a.Storyboard().ActionCount() == b.Storyboard().ActionCount());
+    a.Storyboard().GenerateFrames();
+    b.Storyboard().GenerateFrames();
+    AssertSameFrames(a.Storyboard().Frames(), b.Storyboard().Frames());
+}
+
+void TestSceneFile() {
+    // The old files were written by 32 bit builds.
+    Scene legacy;
+    assert(legacy.Open(L"../Models/glass.scn"));
+    assert(legacy.ShapeObject()->Type() == SHAPE_BEZIER);
+    assert(legacy.Storyboard().ActionCount() > 0);
+
+    // Saved in the new format and read back.
+    assert(legacy.Save(L"test.scn"));
+    Scene scene;
+    assert(scene.Open(L"test.scn"));
+    AssertSameScene(legacy, scene);
+
+    // Old files written by a 64 bit build.
+    Stream stream(L"test_legacy.scn", true);
+    legacy.Serialize(stream);
+    stream.Close();
+    Scene legacy64;
+    assert(legacy64.Open(L"test_legacy.scn"));
+    AssertSameScene(legacy, legacy64);
+
+    // Any damaged byte is detected, and so is a truncated file.
+    stream.Open(L"test.scn");
+    size_t size = stream.Size();
+    char *bytes = new char[size];
+    stream.ReadBlock(bytes, size);
+    stream.Close();
+
+    for(size_t i = 0; i < size; i += 7) {
+        bytes[i] ^= 0x10;
+        stream.Open(L"test_damaged.scn", true);
+        stream.WriteBlock(bytes, size);
+        stream.Close();
+        bytes[i] ^= 0x10;
+
+        // The reserved and padding bytes are not checked, 
+        // but they don't change the scene.
+        Scene damaged;
+        
+        if(damaged.Open(L"test_damaged.scn")) {
+            AssertSameScene(legacy, damaged);
+        }
+    }
+
+    stream.Open(L"test_damaged.scn", true);
+    stream.WriteBlock(bytes, size - 1);
+    stream.Close();
+    assert(!scene.Open(L"test_damaged.scn"));
+    assert(scene.ShapeObject() == NULL);
+
+    delete[] bytes;
+}
+
+// Returns the largest difference between the coordinates of the frames.
+double MaxFrameError(const FrameStore &a, const FrameStore &b) {
+    assert(a.Count() == b.Count());
+    assert(a.PointCount() == b.PointCount());
+    double error = 0;
+
+    for(size_t i = 0; i < a.Count(); i++) {
+        for(size_t j = 0; j < a.PointCount(); j++) {
+            error = std::max(error, fabs(a[i][j].X - b[i][j].X));
+            error = std::max(error, fabs(a[i][j].Y - b[i][j].Y));
+            error = std::max(error, fabs(a[i][j].Z - b[i][j].Z));
+        }
+    }
+
+    return error;
+}
+
+void TestFrameCache() {
+    Scene scene;
+    assert(scene.Open(L"../Models/glass.scn"));
+    Storyboard &storyboard = scene.Storyboard();
+    assert(!storyboard.IsGenerated());
+
+    // Saving evaluates the frames without playing the animation.
+    assert(scene.Save(L"test_cached.scn", true));
+    assert(storyboard.Frames().Count() == 0);
+
+    Scene cached;
+    assert(cached.Open(L"test_cached.scn"));
+    assert(cached.Storyboard().IsGenerated());
+    assert(!cached.Storyboard().NextStep());
+
+    // The first frame is exact, the others are within the tolerance.
+    storyboard.GenerateFrames();
+    FrameStore &expected = storyboard.Frames();
+    FrameStore &actual = cached.Storyboard().Frames();
+    assert(actual.Count() == expected.Count());
+    assert(actual.PointCount() == expected.PointCount());
+    double tolerance = FrameCache::DefaultTolerance(expected) * 1.000001;
+
+    for(size_t i = 0; i < expected.Count(); i++) {
+        for(size_t j = 0; j < expected.PointCount(); j++) {
+            const Point &a = expected[i][j];
+            const Point &b = actual[i][j];
+
+            if(i == 0) {
+                assert((a.X == b.X) && (a.Y == b.Y) && (a.Z == b.Z));
+            }
+            else {
+                assert(fabs(a.X - b.X) <= tolerance);
+                assert(fabs(a.Y - b.Y) <= tolerance);
+                assert(fabs(a.Z - b.Z) <= tolerance);
+            }
+        }
+    }
+
+    // The frames are not saved unless requested.
+    assert(scene.Save(L"test_cached.scn"));
+    assert(cached.Open(L"test_cached.scn"));
+    assert(!cached.Storyboard().IsGenerated());
+    assert(cached.Storyboard().Frames().Count() == 0);
+
+    // Frames saved for another shape or actions are not used.
+    Stream stream;
+    FrameCache::Write(expected, 1, stream);
+    Stream reader(stream.Data(), stream.Size());
+    FrameStore frames;
+    assert(!FrameCache::Read(reader, 2, frames));
+    assert(frames.Count() == 0);
+
+    // Frames generated before the shape changed are not saved.
+    scene.Storyboard().Reset();
+    scene.Storyboard().GenerateFrames();
+    Shape *edited = scene.ShapeObject();
+    assert(edited->Type() == SHAPE_BEZIER);
+    ((BezierShape *)edited)->AnchorPoints()[0].X += 4;
+    double lastX = edited->Points()[0].X;
+    assert(!scene.Storyboard().IsGenerated());
+    assert(scene.Save(L"test_cached.scn", true));
+    assert(cached.Open(L"test_cached.scn"));
+    assert(cached.Storyboard().IsGenerated());
+    FrameStore &restored = cached.Storyboard().Frames();
+    assert(cached.ShapeObject()->Points()[0].X == lastX);
+    scene.Storyboard().Reset();
+    scene.Storyboard().GenerateFrames();
+    FrameStore &current = scene.Storyboard().Frames();
+    assert(MaxFrameError(restored, current) <= FrameCache::DefaultTolerance(current) * 1.000001);
+
+    // A scene without points is saved without frames.
+    Scene empty;
+    empty.SetShape(new Shape());
+    empty.Storyboard().Actions().Add(new TranslateAction(0, 0, 10));
+    assert(empty.Save(L"test_cached.scn", true));
+    assert(cached.Open(L"test_cached.scn"));
+    assert(cached.ShapeObject()->Points().Count() == 0);
+    assert(!cached.Storyboard().IsGenerated());
+
+    // The tolerance of a Bezier shape is saved with it and
+    // the frames cached for another tolerance are not used.
+    List<Point> anchors;
+    List<Point> controls;
+    anchors.Add(Point(0, 0));
+    anchors.Add(Point(100, 50));
+    controls.Add(Point(200, -80));
+    controls.Add(Point(40, 120));
+    BezierShape *bezier = new BezierShape(anchors, controls);
+    bezier->SetTolerance(0.05);
+
+    Scene curved;
+    curved.SetShape(bezier);
+    curved.Storyboard().Actions().Add(new TranslateAction(0, 0, 10));
+    assert(curved.Save(L"test_cached.scn", true));
+    assert(cached.Open(L"test_cached.scn"));
+    assert(((BezierShape *)cached.ShapeObject())->Tolerance() == 0.05);
+    assert(cached.Storyboard().IsGenerated());
+    assert(cached.Storyboard().Frames().PointCount() == bezier->Points().Count());
+
+    assert(cached.SetTolerance(0.005));
+    assert(!cached.Storyboard().IsGenerated());
+    cached.Storyboard().GenerateFrames();
+    assert(cached.Storyboard().Frames().PointCount() > bezier->Points().Count());
+    Scene basic;
+    basic.SetShape(new Shape());
+    assert(!basic.SetTolerance(0.005));
+
+    Stream shape1;
+    Stream shape2;
+    Stream actions;
+    shape1.Write(0.05);
+    shape2.Write(0.005);
+    assert(FrameCache::Key(shape1, actions) != FrameCache::Key(shape2, actions));
+}
+
+void TestFrameCodec() {
+    Shape *shape = ShapeGenerator::Circle(50, 200);
+    Storyboard sb;
+    sb.SetShapeObject(shape);
+    IAction *rotate = new RotateAction(M_PI, ROTATION_ZERO, AXIS_X);
+    rotate->SetSteps(100);
+    IAction *translate = new TranslateAction(0, 0, 30);
+    translate->SetSteps(50);
+    IAction *scale = new ScaleAction(0.5, 0.5, 0.5);
+    scale->SetSteps(50);
+    scale->SetWithPrevious(true);
+    sb.Actions().Add(rotate);
+    sb.Actions().Add(translate);
+    sb.Actions().Add(scale);
+    sb.GenerateFrames();
+    FrameStore &frames = sb.Frames();
+
+    // Smooth animations are much smaller than the points.
+    const double TOLERANCE = 1e-4;
+    Stream stream;
+    stream.Write(FrameCodec(frames, TOLERANCE));
+    assert(stream.Size() * 5 < frames.Count() * frames.PointCount() * 3 * sizeof(double));
+
+    FrameStore decoded;
+    FrameCodec codec(decoded);
+    Stream reader(stream.Data(), stream.Size());
+    reader.Read(codec);
+    assert(!reader.Failed());
+    assert(reader.Remaining() == 0);
+    assert(MaxFrameError(frames, decoded) <= TOLERANCE * 1.000001);
+
+    // Points which jump around need the long codes.
+    FrameStore random;
+    random.Reserve(20, 300);
+    unsigned int seed = 12345;
+
+    for(int i = 0; i < 20; i++) {
+        Frame frame = random.AddFrame();
+
+        for(size_t j = 0; j < frame.Count(); j++) {
+            double values[3];
+
+            for(int k = 0; k < 3; k++) {
+                seed = seed * 1103515245 + 12345;
+                values[k] = ((seed >> 8) / 16777216.0 - 0.5) * 2e6;
+            }
+
+            frame[j] = Point(values[0], values[1], values[2]);
+        }
+    }
+
+    Stream randomStream;
+    randomStream.Write(FrameCodec(random, 1e-3));
+    Stream randomReader(randomStream.Data(), randomStream.Size());
+    randomReader.Read(codec);
+    assert(!randomReader.Failed());
+    assert(MaxFrameError(random, decoded) <= 1e-3 * 1.000001);
+
+    // Truncated data is detected.
+    Stream truncated(stream.Data(), stream.Size() - 1);
+    truncated.Read(codec);
+    assert(truncated.Failed());
+    assert(decoded.Count() == 0);
+
+    // Frames without points are read back as no frames.
+    FrameStore empty;
+    empty.Reserve(3, 0);
+    empty.AddFrame();
+    empty.AddFrame();
+    empty.AddFrame();
+    Stream emptyStream;
+    emptyStream.Write(FrameCodec(empty, 1e-3));
+    Stream emptyReader(emptyStream.Data(), emptyStream.Size());
+    emptyReader.Read(codec);
+    assert(!emptyReader.Failed());
+    assert(decoded.Count() == 0);
+    delete shape;
+}
+
+void TestFloatPipeline() {
+    assert(sizeof(PointF) == 3 * sizeof(float));
+
+    Shape *shape = ShapeGenerator::Circle(50, 200);
+    Storyboard sb;
+    sb.SetShapeObject(shape);
+    IAction *translate = new TranslateAction(30, 0, 0);
+    translate->SetSteps(20);
+    IAction *rotate = new RotateAction(M_PI / 2, ROTATION_ZERO, AXIS_Y);
+    rotate->SetSteps(40);
+    sb.Actions().Add(translate);
+    sb.Actions().Add(rotate);
+    sb.GenerateFrames();
+
+    // The float frames are the double ones, rounded.
+    ThreadPool pool(2);
+    FrameStoreF frames;
+    sb.GenerateFrames(frames, &pool);
+    FrameStore &expected = sb.Frames();
+    assert(frames.Count() == expected.Count());
+    assert(frames.PointCount() == expected.PointCount());
+
+    for(size_t i = 0; i < frames.Count(); i++) {
+        for(size_t j = 0; j < frames.PointCount(); j++) {
+            assert(frames[i][j].ToPoint().Distance(expected[i][j]) < 1e-4);
+        }
+    }
+
+    PointBufferF buffer;
+    sb.EvaluateAt(30, buffer);
+
+    for(size_t j = 0; j < buffer.Count(); j++) {
+        assert(buffer.Get(j).Distance(expected[30][j]) < 1e-4);
+    }
+
+    // All float kernels give the same points.
+    const size_t COUNT = 1003; // Not a multiple of the vector width.
+    float x[COUNT], y[COUNT], z[COUNT];
+    float outX[COUNT], outY[COUNT], outZ[COUNT];
+
+    for(size_t i = 0; i < COUNT; i++) {
+        x[i] = (float)i;
+        y[i] = (float)(i % 7) - 3;
+        z[i] = (float)(i % 13) * 0.5f;
+    }
+
+    Transform t = Transform::RotationY(0.3, Point(1, 2, 3)) * Transform::Scaling(2, 1, 0.5);
+    KernelLevel supported = TransformKernel::SupportedLevel();
+
+    for(int level = KERNEL_SCALAR; level <= supported; level++) {
+        TransformKernel::SetLevel((KernelLevel)level);
+        TransformKernel::Apply(t, x, y, z, outX, outY, outZ, COUNT);
+
+        for(size_t i = 0; i < COUNT; i++) {
+            Point point = t.Apply(Point(x[i], y[i], z[i]));
+            assert(point.Distance(Point(outX[i], outY[i], outZ[i])) < 1e-3);
+        }
+    }
+
+    TransformKernel::SetLevel(supported);
+
+    // The float mesh has the same triangles and nearly the same normals
+    // (the bend has thin triangles, whose normals lose a few digits).
+    MeshBuilder builder;
+    builder.Update(expected);
+    MeshBuilderF builderF;
+    builderF.Update(frames);
+    Mesh &mesh = builder.MeshObject();
+    MeshF &meshF = builderF.MeshObject();
+    assert(meshF.VertexCount() == mesh.VertexCount());
+    assert(meshF.Indices().Count() == mesh.Indices().Count());
+
+    for(size_t i = 0; i < meshF.Indices().Count(); i++) {
+        assert(meshF.Indices()[i] == mesh.Indices()[i]);
+    }
+
+    for(size_t i = 0; i < meshF.VertexCount(); i++) {
+        assert(meshF.Normals()[i].ToPoint().Distance(mesh.Normals()[i]) < 1e-2);
+    }
+
+    delete shape;
 }
 
 #endif
@@ -0,0 +1,249 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include "List.hpp"
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Interface that must be implemented by work executed on a ThreadPool.
+// Run is called for disjoint ranges of [0, count), possibly in parallel.
+class IRangeTask {
+public:
+    virtual void Run(size_t begin, size_t end) = 0;
+};
+
+// A work-stealing thread pool. Each worker has its own queue; it takes work
+// from the back of it and, when empty, steals from the front of the others.
+// Threads waiting for their work to finish help executing queued work, 
+// so ParallelFor can be called from inside a task.
+class ThreadPool {
+private:
+    // Tracks the jobs of a ParallelFor call.
+    struct Batch {
+        std::mutex lock;
+        std::condition_variable done;
+        size_t remaining;
+    };
+
+    struct Job {
+        IRangeTask *task;
+        size_t begin;
+        size_t end;
+        Batch *batch;
+    };
+
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<Job> jobs;
+    };
+
+    List<std::thread *> threads_;
+    List<WorkQueue *> queues_;
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+    std::atomic<size_t> queued_;
+    bool stopping_;
+
+public:
+    //
+    // Constructors / destructor.
+    //
+    // Creates a pool with the given number of worker threads.
+    // If it's 0, one thread per hardware thread is created.
+    ThreadPool(size_t threadCount = 0) : queued_(0), stopping_(false) {
+        if(threadCount == 0) {
+            threadCount = std::max(1U, std::thread::hardware_concurrency());
+        }
+
+        for(size_t i = 0; i < threadCount; i++) {
+            queues_.Add(new WorkQueue());
+        }
+
+        for(size_t i = 0; i < threadCount; i++) {
+            threads_.Add(new std::thread(&ThreadPool::WorkerLoop, this, i));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock_);
+            stopping_ = true;
+        }
+
+        wake_.notify_all();
+
+        // The queues are deleted only after all workers stopped,
+        // because a worker can still steal from any of them.
+        for(size_t i = 0; i < threads_.Count(); i++) {
+            threads_[i]->join();
+            delete threads_[i];
+        }
+
+        for(size_t i = 0; i < queues_.Count(); i++) {
+            delete queues_[i];
+        }
+    }
+
+    //
+    // Public methods.
+    //
+    size_t ThreadCount() const {
+        return threads_.Count();
+    }
+
+    // Runs the task over [0, count), split into ranges of at most 'grain'
+    // elements, and returns after all of them were executed.
+    void ParallelFor(IRangeTask &task, size_t count, size_t grain = 1) {
+        if(count == 0) return;
+        if(grain == 0) grain = 1;
+
+        if(count <= grain) {
+            task.Run(0, count);
+            return;
+        }
+
+        Batch batch;
+        batch.remaining = (count + grain - 1) / grain;
+        queued_ += batch.remaining;
+
+        // Distribute the ranges evenly between the workers.
+        for(size_t begin = 0, i = 0; begin < count; begin += grain, i++) {
+            Job job = { &task, begin, std::min(begin + grain, count), &batch };
+            WorkQueue *queue = queues_[i % queues_.Count()];
+
+            std::lock_guard<std::mutex> guard(queue->lock);
+            queue->jobs.push_back(job);
+        }
+
+        {
+            // Makes sure no worker misses the wake up.
+            std::lock_guard<std::mutex> guard(sleepLock_);
+        }
+
+        wake_.notify_all();
+
+        // Help with the queued work until there is nothing left to take,
+        // then wait for the ranges still executing on the workers.
+        Job job;
+
+        while(IsPending(batch) && TakeJob(0, false, job)) {
+            RunJob(job);
+        }
+
+        std::unique_lock<std::mutex> lock(batch.lock);
+
+        while(batch.remaining > 0) {
+            batch.done.wait(lock);
+        }
+    }
+
+private:
+    ThreadPool(const ThreadPool &other);
+    ThreadPool &operator =(const ThreadPool &other);
+
+    void WorkerLoop(size_t index) {
+        while(true) {
+            Job job;
+
+            if(TakeJob(index, true, job)) {
+                RunJob(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock_);
+
+            while(!stopping_ && (queued_ == 0)) {
+                wake_.wait(lock);
+            }
+
+            if(stopping_ && (queued_ == 0)) {
+                return;
+            }
+        }
+    }
+
+    // Takes a job from the back of the own queue (if 'owner' is set),
+    // or steals one from the front of the other queues.
+    bool TakeJob(size_t index, bool owner, Job &job) {
+        size_t count = queues_.Count();
+
+        for(size_t i = 0; i < count; i++) {
+            WorkQueue *queue = queues_[(index + i) % count];
+            std::lock_guard<std::mutex> guard(queue->lock);
+
+            if(queue->jobs.empty()) {
+                continue;
+            }
+
+            if(owner && (i == 0)) {
+                job = queue->jobs.back();
+                queue->jobs.pop_back();
+            }
+            else {
+                job = queue->jobs.front();
+                queue->jobs.pop_front();
+            }
+
+            queued_--;
+            return true;
+        }
+
+        return false;
+    }
+
+    void RunJob(const Job &job) {
+        job.task->Run(job.begin, job.end);
+
+        // The notification is sent while holding the lock, because
+        // the batch is destroyed as soon as the waiting thread sees
+        // that no work remains.
+        std::lock_guard<std::mutex> guard(job.batch->lock);
+
+        if(--job.batch->remaining == 0) {
+            job.batch->done.notify_all();
+        }
+    }
+
+    bool IsPending(Batch &batch) {
+        std::lock_guard<std::mutex> guard(batch.lock);
+        return batch.remaining > 0;
+    }
+};
+
+#endif
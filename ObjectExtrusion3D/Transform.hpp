@@ -0,0 +1,272 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include "Point.hpp"
+#include "FrameStore.hpp"
+#include "ThreadPool.hpp"
+#include "ISerializable.hpp"
+#include "Stream.hpp"
+#include <cmath>
+
+// An affine transform, stored as the top three rows of a 4x4 matrix
+// (the last row is always 0 0 0 1).
+class Transform : public ISerializable {
+private:
+    // Applies a transform to a range of points.
+    template <class P>
+    class ApplyTask : public IRangeTask {
+    private:
+        const Transform *transform_;
+        const BasicFrame<P> *source_;
+        BasicFrame<P> *dest_;
+
+    public:
+        ApplyTask(const Transform *transform, const BasicFrame<P> *source, 
+                  BasicFrame<P> *dest) :
+                transform_(transform), source_(source), dest_(dest) {}
+
+        virtual void Run(size_t begin, size_t end) {
+            BasicFrame<P> destRange = dest_->Slice(begin, end);
+            transform_->Apply(source_->Slice(begin, end), destRange);
+        }
+    };
+
+    double m_[3][4];
+
+public:
+    // Frames with fewer points are always transformed on the calling thread.
+    static const size_t PARALLEL_THRESHOLD = 65536;
+    // The size of the points transformed by a task (about half of a 512 KB
+    // L2 cache): 8192 Point (32 bytes each) or 21845 PointF (12 bytes each).
+    static const size_t BYTES_PER_CHUNK = 262144;
+
+public:
+    //
+    // Constructors.
+    //
+    Transform() {
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 4; j++) {
+                m_[i][j] = (i == j) ? 1 : 0;
+            }
+        }
+    }
+
+    //
+    // Factory methods.
+    //
+    static Transform Identity() {
+        return Transform();
+    }
+
+    static Transform Translation(double dx, double dy, double dz) {
+        Transform t;
+        t.m_[0][3] = dx;
+        t.m_[1][3] = dy;
+        t.m_[2][3] = dz;
+        return t;
+    }
+
+    static Transform Scaling(double sx, double sy, double sz, 
+                             const Point &origin = Point()) {
+        Transform t;
+        t.m_[0][0] = sx;
+        t.m_[1][1] = sy;
+        t.m_[2][2] = sz;
+        return AroundOrigin(t, origin);
+    }
+
+    static Transform RotationX(double angle, const Point &origin = Point()) {
+        Transform t;
+        double sinA = sin(angle);
+        double cosA = cos(angle);
+        t.m_[1][1] = cosA;  t.m_[1][2] = -sinA;
+        t.m_[2][1] = sinA;  t.m_[2][2] = cosA;
+        return AroundOrigin(t, origin);
+    }
+
+    static Transform RotationY(double angle, const Point &origin = Point()) {
+        Transform t;
+        double sinA = sin(angle);
+        double cosA = cos(angle);
+        t.m_[0][0] = cosA;  t.m_[0][2] = sinA;
+        t.m_[2][0] = -sinA; t.m_[2][2] = cosA;
+        return AroundOrigin(t, origin);
+    }
+
+    static Transform RotationZ(double angle, const Point &origin = Point()) {
+        Transform t;
+        double sinA = sin(angle);
+        double cosA = cos(angle);
+        t.m_[0][0] = cosA;  t.m_[0][1] = -sinA;
+        t.m_[1][0] = sinA;  t.m_[1][1] = cosA;
+        return AroundOrigin(t, origin);
+    }
+
+    //
+    // Public methods.
+    //
+    double Get(int row, int column) const {
+        return m_[row][column];
+    }
+
+    // Returns true if the transform changes all distances by the same factor
+    // (it's made only of rotations, translations and uniform scaling).
+    // 'scale' receives the factor.
+    bool IsSimilarity(double &scale) const {
+        const double EPSILON = 1e-9;
+        double lengths[3];
+
+        for(int i = 0; i < 3; i++) {
+            lengths[i] = m_[0][i] * m_[0][i] + m_[1][i] * m_[1][i] + m_[2][i] * m_[2][i];
+        }
+
+        // The columns of the linear part must be orthogonal and of the same length.
+        double tolerance = EPSILON * lengths[0];
+        scale = sqrt(lengths[0]);
+
+        for(int i = 0; i < 3; i++) {
+            int j = (i + 1) % 3;
+            double dot = m_[0][i] * m_[0][j] + m_[1][i] * m_[1][j] + m_[2][i] * m_[2][j];
+
+            if((fabs(lengths[i] - lengths[0]) > tolerance) || (fabs(dot) > tolerance)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    Point Apply(const Point &point) const {
+        return Point(m_[0][0] * point.X + m_[0][1] * point.Y + m_[0][2] * point.Z + m_[0][3],
+                     m_[1][0] * point.X + m_[1][1] * point.Y + m_[1][2] * point.Z + m_[1][3],
+                     m_[2][0] * point.X + m_[2][1] * point.Y + m_[2][2] * point.Z + m_[2][3]);
+    }
+
+    template <class P>
+    void Apply(BasicFrame<P> &points) const {
+        Apply(points, points);
+    }
+
+    // Writes the transformed source points into 'dest'.
+    // The two frames can be the same. Float frames are transformed
+    // with a float copy of the matrix.
+    template <class P>
+    void Apply(const BasicFrame<P> &source, BasicFrame<P> &dest) const {
+        assert(source.Count() == dest.Count());
+        // --------------------------------
+        typedef typename P::Scalar Scalar;
+        Scalar m[3][4];
+
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 4; j++) {
+                m[i][j] = (Scalar)m_[i][j];
+            }
+        }
+
+        for(size_t i = 0; i < source.Count(); i++) {
+            const P &point = source[i];
+            Scalar x = point.X;
+            Scalar y = point.Y;
+            Scalar z = point.Z;
+
+            P &result = dest[i];
+            result.X = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+            result.Y = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+            result.Z = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+        }
+    }
+
+    // Same as above, but large frames are split into chunks which are
+    // transformed in parallel on the pool. The results are identical.
+    template <class P>
+    void Apply(const BasicFrame<P> &source, BasicFrame<P> &dest, 
+               ThreadPool *pool) const {
+        assert(source.Count() == dest.Count());
+        // --------------------------------
+        if((pool == NULL) || (source.Count() < PARALLEL_THRESHOLD)) {
+            Apply(source, dest);
+            return;
+        }
+
+        ApplyTask<P> task(this, &source, &dest);
+        pool->ParallelFor(task, source.Count(), BYTES_PER_CHUNK / sizeof(P));
+    }
+
+    //
+    // Serialization.
+    //
+    virtual void Serialize(Stream &stream) const {
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 4; j++) {
+                stream.Write(m_[i][j]);
+            }
+        }
+    }
+
+    virtual void Deserialize(Stream &stream) {
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 4; j++) {
+                stream.Read(m_[i][j]);
+            }
+        }
+    }
+
+    // Composes the transforms; the result applies 'other' first, then this.
+    Transform operator *(const Transform &other) const {
+        Transform t;
+
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 4; j++) {
+                t.m_[i][j] = m_[i][0] * other.m_[0][j] +
+                             m_[i][1] * other.m_[1][j] +
+                             m_[i][2] * other.m_[2][j];
+            }
+
+            t.m_[i][3] += m_[i][3];
+        }
+
+        return t;
+    }
+
+private:
+    // Makes the linear transform 't' act around 'origin' instead of (0, 0, 0).
+    static Transform AroundOrigin(const Transform &t, const Point &origin) {
+        return Translation(origin.X, origin.Y, origin.Z) * t *
+               Translation(-origin.X, -origin.Y, -origin.Z);
+    }
+};
+
+#endif
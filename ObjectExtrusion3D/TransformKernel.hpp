@@ -0,0 +1,319 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRANSFORM_KERNEL_HPP
+#define TRANSFORM_KERNEL_HPP
+
+#include "Transform.hpp"
+#include <cstdlib>
+#include <atomic>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+    #define KERNEL_X86
+    #include <emmintrin.h>
+    #include <immintrin.h>
+
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define KERNEL_TARGET_AVX2
+    #else
+        #include <cpuid.h>
+        #define KERNEL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #endif
+#endif
+
+enum KernelLevel {
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+};
+
+// Applies an affine transform to coordinates stored as separate
+// X, Y and Z arrays. The best instruction set supported by the processor
+// is selected the first time the kernel is used. The coordinates can be
+// double or float; float kernels process twice as many points per instruction.
+class TransformKernel {
+private:
+    static std::atomic<int> detectedLevel_; // -1 until the processor is queried.
+    static std::atomic<int> currentLevel_;  // -1 selects the detected level.
+
+public:
+    //
+    // Public methods.
+    //
+    static KernelLevel Level() {
+        return CurrentLevel();
+    }
+
+    // Forces the use of a kernel (used by tests and benchmarks).
+    // Levels not supported by the processor are ignored.
+    static void SetLevel(KernelLevel level) {
+        if(level <= DetectLevel()) {
+            currentLevel_ = level;
+        }
+    }
+
+    static KernelLevel SupportedLevel() {
+        return DetectLevel();
+    }
+
+    // Transforms 'count' points. The output arrays can be the same
+    // as the input ones. T is double or float.
+    template <class T>
+    static void Apply(const Transform &t, const T *x, const T *y, 
+                      const T *z, T *outX, T *outY, T *outZ, size_t count) {
+        size_t done = 0;
+
+#ifdef KERNEL_X86
+        switch(CurrentLevel()) {
+            case KERNEL_SCALAR: {
+                break;
+            }
+            case KERNEL_AVX2: {
+                done = ApplyAVX2(t, x, y, z, outX, outY, outZ, count);
+                break;
+            }
+            case KERNEL_SSE2: {
+                done = ApplySSE2(t, x, y, z, outX, outY, outZ, count);
+                break;
+            }
+        }
+#endif
+
+        // The points left over by the vector kernels.
+        ApplyScalar(t, x + done, y + done, z + done, 
+                    outX + done, outY + done, outZ + done, count - done);
+    }
+
+private:
+    static KernelLevel CurrentLevel() {
+        int level = currentLevel_;
+        return level == -1 ? DetectLevel() : (KernelLevel)level;
+    }
+
+    // Pool workers can use the kernel for the first time concurrently.
+    // They all find the same level, so storing it twice is harmless.
+    static KernelLevel DetectLevel() {
+        int level = detectedLevel_;
+
+        if(level == -1) {
+            level = QueryLevel();
+            detectedLevel_ = level;
+        }
+
+        return (KernelLevel)level;
+    }
+
+    static KernelLevel QueryLevel() {
+#ifdef KERNEL_X86
+        // AVX2 and FMA must be supported by the processor,
+        // and the AVX state must be saved by the operating system.
+        unsigned int info[4];
+        CpuId(1, info);
+        bool hasFMA = (info[2] & (1 << 12)) != 0;
+        bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+        bool hasAVX = (info[2] & (1 << 28)) != 0;
+
+        if(hasFMA && hasOSXSAVE && hasAVX && ((GetXCR0() & 6) == 6)) {
+            CpuId(7, info);
+            bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+
+            if(hasAVX2) {
+                return KERNEL_AVX2;
+            }
+        }
+
+        return KERNEL_SSE2;
+#else
+        return KERNEL_SCALAR;
+#endif
+    }
+
+    template <class T>
+    static void ApplyScalar(const Transform &t, const T *x, const T *y, 
+                            const T *z, T *outX, T *outY, T *outZ, size_t count) {
+        T m00 = (T)t.Get(0, 0), m01 = (T)t.Get(0, 1), m02 = (T)t.Get(0, 2), m03 = (T)t.Get(0, 3);
+        T m10 = (T)t.Get(1, 0), m11 = (T)t.Get(1, 1), m12 = (T)t.Get(1, 2), m13 = (T)t.Get(1, 3);
+        T m20 = (T)t.Get(2, 0), m21 = (T)t.Get(2, 1), m22 = (T)t.Get(2, 2), m23 = (T)t.Get(2, 3);
+
+        for(size_t i = 0; i < count; i++) {
+            T px = x[i];
+            T py = y[i];
+            T pz = z[i];
+            outX[i] = m00 * px + m01 * py + m02 * pz + m03;
+            outY[i] = m10 * px + m11 * py + m12 * pz + m13;
+            outZ[i] = m20 * px + m21 * py + m22 * pz + m23;
+        }
+    }
+
+#ifdef KERNEL_X86
+    static void CpuId(int function, unsigned int info[4]) {
+    #if defined(_MSC_VER)
+        __cpuidex((int *)info, function, 0);
+    #else
+        __cpuid_count(function, 0, info[0], info[1], info[2], info[3]);
+    #endif
+    }
+
+    static unsigned long long GetXCR0() {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long)edx << 32) | eax;
+    #endif
+    }
+
+    // Returns the number of points that were transformed.
+    static size_t ApplySSE2(const Transform &t, const double *x, const double *y, 
+                            const double *z, double *outX, double *outY, 
+                            double *outZ, size_t count) {
+        __m128d m00 = _mm_set1_pd(t.Get(0, 0)), m01 = _mm_set1_pd(t.Get(0, 1));
+        __m128d m02 = _mm_set1_pd(t.Get(0, 2)), m03 = _mm_set1_pd(t.Get(0, 3));
+        __m128d m10 = _mm_set1_pd(t.Get(1, 0)), m11 = _mm_set1_pd(t.Get(1, 1));
+        __m128d m12 = _mm_set1_pd(t.Get(1, 2)), m13 = _mm_set1_pd(t.Get(1, 3));
+        __m128d m20 = _mm_set1_pd(t.Get(2, 0)), m21 = _mm_set1_pd(t.Get(2, 1));
+        __m128d m22 = _mm_set1_pd(t.Get(2, 2)), m23 = _mm_set1_pd(t.Get(2, 3));
+        size_t vectorCount = count & ~(size_t)1;
+
+        for(size_t i = 0; i < vectorCount; i += 2) {
+            __m128d px = _mm_loadu_pd(x + i);
+            __m128d py = _mm_loadu_pd(y + i);
+            __m128d pz = _mm_loadu_pd(z + i);
+
+            __m128d rx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m00, px), _mm_mul_pd(m01, py)),
+                                    _mm_add_pd(_mm_mul_pd(m02, pz), m03));
+            __m128d ry = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m10, px), _mm_mul_pd(m11, py)),
+                                    _mm_add_pd(_mm_mul_pd(m12, pz), m13));
+            __m128d rz = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m20, px), _mm_mul_pd(m21, py)),
+                                    _mm_add_pd(_mm_mul_pd(m22, pz), m23));
+            _mm_storeu_pd(outX + i, rx);
+            _mm_storeu_pd(outY + i, ry);
+            _mm_storeu_pd(outZ + i, rz);
+        }
+
+        return vectorCount;
+    }
+
+    KERNEL_TARGET_AVX2
+    static size_t ApplyAVX2(const Transform &t, const double *x, const double *y, 
+                            const double *z, double *outX, double *outY, 
+                            double *outZ, size_t count) {
+        __m256d m00 = _mm256_set1_pd(t.Get(0, 0)), m01 = _mm256_set1_pd(t.Get(0, 1));
+        __m256d m02 = _mm256_set1_pd(t.Get(0, 2)), m03 = _mm256_set1_pd(t.Get(0, 3));
+        __m256d m10 = _mm256_set1_pd(t.Get(1, 0)), m11 = _mm256_set1_pd(t.Get(1, 1));
+        __m256d m12 = _mm256_set1_pd(t.Get(1, 2)), m13 = _mm256_set1_pd(t.Get(1, 3));
+        __m256d m20 = _mm256_set1_pd(t.Get(2, 0)), m21 = _mm256_set1_pd(t.Get(2, 1));
+        __m256d m22 = _mm256_set1_pd(t.Get(2, 2)), m23 = _mm256_set1_pd(t.Get(2, 3));
+        size_t vectorCount = count & ~(size_t)3;
+
+        for(size_t i = 0; i < vectorCount; i += 4) {
+            __m256d px = _mm256_loadu_pd(x + i);
+            __m256d py = _mm256_loadu_pd(y + i);
+            __m256d pz = _mm256_loadu_pd(z + i);
+
+            __m256d rx = _mm256_fmadd_pd(m00, px, _mm256_fmadd_pd(m01, py, _mm256_fmadd_pd(m02, pz, m03)));
+            __m256d ry = _mm256_fmadd_pd(m10, px, _mm256_fmadd_pd(m11, py, _mm256_fmadd_pd(m12, pz, m13)));
+            __m256d rz = _mm256_fmadd_pd(m20, px, _mm256_fmadd_pd(m21, py, _mm256_fmadd_pd(m22, pz, m23)));
+            _mm256_storeu_pd(outX + i, rx);
+            _mm256_storeu_pd(outY + i, ry);
+            _mm256_storeu_pd(outZ + i, rz);
+        }
+
+        return vectorCount;
+    }
+
+    static size_t ApplySSE2(const Transform &t, const float *x, const float *y, 
+                            const float *z, float *outX, float *outY, 
+                            float *outZ, size_t count) {
+        __m128 m00 = _mm_set1_ps((float)t.Get(0, 0)), m01 = _mm_set1_ps((float)t.Get(0, 1));
+        __m128 m02 = _mm_set1_ps((float)t.Get(0, 2)), m03 = _mm_set1_ps((float)t.Get(0, 3));
+        __m128 m10 = _mm_set1_ps((float)t.Get(1, 0)), m11 = _mm_set1_ps((float)t.Get(1, 1));
+        __m128 m12 = _mm_set1_ps((float)t.Get(1, 2)), m13 = _mm_set1_ps((float)t.Get(1, 3));
+        __m128 m20 = _mm_set1_ps((float)t.Get(2, 0)), m21 = _mm_set1_ps((float)t.Get(2, 1));
+        __m128 m22 = _mm_set1_ps((float)t.Get(2, 2)), m23 = _mm_set1_ps((float)t.Get(2, 3));
+        size_t vectorCount = count & ~(size_t)3;
+
+        for(size_t i = 0; i < vectorCount; i += 4) {
+            __m128 px = _mm_loadu_ps(x + i);
+            __m128 py = _mm_loadu_ps(y + i);
+            __m128 pz = _mm_loadu_ps(z + i);
+
+            __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)),
+                                   _mm_add_ps(_mm_mul_ps(m02, pz), m03));
+            __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)),
+                                   _mm_add_ps(_mm_mul_ps(m12, pz), m13));
+            __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py)),
+                                   _mm_add_ps(_mm_mul_ps(m22, pz), m23));
+            _mm_storeu_ps(outX + i, rx);
+            _mm_storeu_ps(outY + i, ry);
+            _mm_storeu_ps(outZ + i, rz);
+        }
+
+        return vectorCount;
+    }
+
+    KERNEL_TARGET_AVX2
+    static size_t ApplyAVX2(const Transform &t, const float *x, const float *y, 
+                            const float *z, float *outX, float *outY, 
+                            float *outZ, size_t count) {
+        __m256 m00 = _mm256_set1_ps((float)t.Get(0, 0)), m01 = _mm256_set1_ps((float)t.Get(0, 1));
+        __m256 m02 = _mm256_set1_ps((float)t.Get(0, 2)), m03 = _mm256_set1_ps((float)t.Get(0, 3));
+        __m256 m10 = _mm256_set1_ps((float)t.Get(1, 0)), m11 = _mm256_set1_ps((float)t.Get(1, 1));
+        __m256 m12 = _mm256_set1_ps((float)t.Get(1, 2)), m13 = _mm256_set1_ps((float)t.Get(1, 3));
+        __m256 m20 = _mm256_set1_ps((float)t.Get(2, 0)), m21 = _mm256_set1_ps((float)t.Get(2, 1));
+        __m256 m22 = _mm256_set1_ps((float)t.Get(2, 2)), m23 = _mm256_set1_ps((float)t.Get(2, 3));
+        size_t vectorCount = count & ~(size_t)7;
+
+        for(size_t i = 0; i < vectorCount; i += 8) {
+            __m256 px = _mm256_loadu_ps(x + i);
+            __m256 py = _mm256_loadu_ps(y + i);
+            __m256 pz = _mm256_loadu_ps(z + i);
+
+            __m256 rx = _mm256_fmadd_ps(m00, px, _mm256_fmadd_ps(m01, py, _mm256_fmadd_ps(m02, pz, m03)));
+            __m256 ry = _mm256_fmadd_ps(m10, px, _mm256_fmadd_ps(m11, py, _mm256_fmadd_ps(m12, pz, m13)));
+            __m256 rz = _mm256_fmadd_ps(m20, px, _mm256_fmadd_ps(m21, py, _mm256_fmadd_ps(m22, pz, m23)));
+            _mm256_storeu_ps(outX + i, rx);
+            _mm256_storeu_ps(outY + i, ry);
+            _mm256_storeu_ps(outZ + i, rz);
+        }
+
+        return vectorCount;
+    }
+#endif
+};
+
+std::atomic<int> TransformKernel::detectedLevel_(-1);
+std::atomic<int> TransformKernel::currentLevel_(-1);
+
+#endif
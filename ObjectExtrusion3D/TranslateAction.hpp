@@ -36,6 +36,7 @@
 #include "IAction.hpp"
 #include "Point.hpp"
 #include "List.hpp"
+#include "FrameStore.hpp"
 #include "ISerializable.hpp"
 #include "Stream.hpp"
 
@@ -85,18 +86,10 @@ public:
         deltaZ_ = value;
     }
 
-    virtual void Execute(int step, List<Point> &points) {
-        double dx = deltaX_ / (double)steps_;
-        double dy = deltaY_ / (double)steps_;
-        double dz = deltaZ_ / (double)steps_;
-        size_t count = points.Count();
-
-        for(size_t i = 0; i < count; i++) {
-            Point &point = points[i];
-            point.X += dx;
-            point.Y += dy;
-            point.Z += dz;
-        }
+    virtual Transform StepTransform(int step, const Frame &points) {
+        return Transform::Translation(deltaX_ / (double)steps_,
+                                      deltaY_ / (double)steps_,
+                                      deltaZ_ / (double)steps_);
     }
 
     //
@@ -39,6 +39,10 @@
 #include "ScaleAction.hpp"
 #include "IAction.hpp"
 #include "Storyboard.hpp"
+#include "FrameStore.hpp"
+#include "MeshBuilder.hpp"
+#include "StlExporter.hpp"
+#include "MeshExporter.hpp"
 #include "BasicShapes.hpp"
 #include "RotateAction.hpp"
 #include "Scene.hpp"
@@ -102,12 +106,18 @@ static const int SAVE_ID = 43;
 static const int ROTATE_X = 44;
 static const int ROTATE_Y = 45;
 static const int ROTATE_Z = 46;
+static const int EXPORT_STL_ID = 47;
+static const int EXPORT_OBJ_ID = 48;
+static const int EXPORT_PLY_ID = 49;
+static const int TOLERANCE_ID = 50;
 
 int window_;
 Scene scene_;
+MeshBuilderF meshBuilder_; // Drawn with float vertices, so it's built in float.
 
 int showAxis_;
 int showWireframe_;
+int saveFrames_; // Saves the frames with the scene, so it opens already extruded.
 int onZ;
 
 GLUI_Listbox *axisList_;
@@ -120,6 +130,8 @@ GLUI_Button *editButton;
 GLUI_Listbox *shapeList_;
 int shapePoints_;
 int shapeSize_;
+GLUI_Spinner *toleranceSpinner_;
+float tolerance_; // Of Bezier shapes, 0 for a fixed number of points per curve.
 
 int rotateCount_ = 0;
 int translateCount_ = 0;
@@ -282,25 +294,6 @@ void DisplayEdit() {
     }
 }
 
-void Normal(const Point &a, const Point &b, const Point &c) {
-    double px = a.X - b.X;
-    double py = a.Y - b.Y;
-    double pz = a.Z - b.Z;
-    double qx = c.X - b.X;
-    double qy = c.Y - b.Y;
-    double qz = c.Z - b.Z;
-
-    Point normal = Point(py * qz - pz * qy,
-                         px * qz - pz * qx,
-                         px * qy - py * qx);		 
-    double mag = normal.Magnitutde();
-    normal.X /= mag;
-    normal.Y /= mag;
-    normal.Z /= mag;
-
-    glNormal3f(normal.X, normal.Y, normal.Z);
-}
-
 void DisplayPlay() {
     glRotatef(rotationY_, 0, 1, 0);
     glRotatef(rotationZ_, 0, 0, 1);
@@ -312,44 +305,21 @@ void DisplayPlay() {
     glMaterialfv(GL_FRONT, GL_SPECULAR, specReflection);
     glMateriali(GL_FRONT,GL_SHININESS, 200);
 
-    // Build the surfaces by conecting the set of points.
-    List<Point> *a;
-    size_t listCount = scene_.Storyboard().Points().Count();
-
-    for(size_t i = 0; i < listCount; i++) {
-        List<Point> *b = scene_.Storyboard().Points()[i];
-
-        if(i > 0) {
-            glBegin(GL_QUAD_STRIP);
-                for(size_t j = 0; j < b->Count(); j++) {
-                    glColor3f(0.3, 0.0, 1.0);				
-
-                    // Compute the normal to the surface.
-                    if(j < b->Count ()- 1) {
-                        Normal((*b)[j], (*b)[j + 1], (*a)[j]);
-                    }
-                    else {
-                        Normal((*b)[j], (*b)[j - 1], (*a)[j]);
-                    }
-
-                    glVertex3f((*a)[j].X, (*a)[j].Y, (*a)[j].Z);
-                    glColor3f(0.3, 0.0, 1.0);
-                    
-                    if(j < b->Count ()- 1) {
-                        Normal((*b)[j], (*b)[j + 1], (*a)[j]);
-                    }
-                    else {
-                        Normal((*b)[j], (*b)[j - 1], (*a)[j]);
-                    }
-
-
-                    glVertex3f((*b)[j].X, (*b)[j].Y, (*b)[j].Z);
-                }
-            glEnd();
+    // Add the frames generated since the last redraw to the mesh
+    // which connects them, then draw its triangles.
+    meshBuilder_.Update(scene_.Storyboard().Frames());
+    MeshF &mesh = meshBuilder_.MeshObject();
+    List<PointF> &vertices = mesh.Vertices();
+    List<PointF> &normals = mesh.Normals();
+    List<size_t> &indices = mesh.Indices();
+
+    glColor3f(0.3, 0.0, 1.0);
+    glBegin(GL_TRIANGLES);
+        for(size_t i = 0; i < indices.Count(); i++) {
+            glNormal3fv(&normals[indices[i]].X);
+            glVertex3fv(&vertices[indices[i]].X);
         }
-
-        a = b;
-    }
+    glEnd();
 }
 
 void DisplayAxis() {
@@ -450,6 +420,8 @@ void LoadShape(int id, double size, int points) {
             break;
         }
     }
+
+    scene_.SetTolerance(tolerance_);
 }
 
 void AddPoint(int x, int y, Shape *shape) {
@@ -534,6 +506,12 @@ void ClearActionList() {
     }
 }
 
+void ResetScene() {
+    scene_.Storyboard().Reset();
+    meshBuilder_.Clear();
+    scene_.SetState(SCENE_EDIT);
+}
+
 void RemoveAllActions() {
     for(size_t i = 0; i < scene_.Storyboard().ActionCount(); i++) {
         delete scene_.Storyboard().Actions()[i];
@@ -549,6 +527,8 @@ void RemoveAllActions() {
 }
 
 void RemoveAction(IAction *action) {
+    // The frames shown were generated with the action.
+    ResetScene();
     ClearActionList();
     scene_.Storyboard().Actions().Remove(action);
     delete action;
@@ -595,11 +575,9 @@ void UpdateAction(IAction *action) {
             break;
         }
     }
-}
 
-void ResetScene() {
-    scene_.Storyboard().Reset();
-    scene_.SetState(SCENE_EDIT);
+    // Recompute only the frames which depend on the action.
+    meshBuilder_.RemoveFrames(scene_.Storyboard().ActionChanged(action));
 }
 
 void Play() {
@@ -677,6 +655,7 @@ IAction* AddAction() {
     }
 
     action->SetSteps(32);
+    ResetScene();
     ClearActionList();
     scene_.Storyboard().Actions().Add(action);
     PopulateActionList();
@@ -708,6 +687,15 @@ void Open() {
 
         if(scene_.Open(ofn.lpstrFile)) {		
             PopulateActionList();
+
+            if(scene_.ShapeObject()->Type() == SHAPE_BEZIER) {
+                tolerance_ = (float)((BezierShape *)scene_.ShapeObject())->Tolerance();
+                toleranceSpinner_->set_float_val(tolerance_);
+            }
+
+            // Scenes saved with their frames are shown extruded right away.
+            meshBuilder_.Clear();
+            scene_.SetState(scene_.Storyboard().IsGenerated() ? SCENE_END : SCENE_EDIT);
         }
         else {
             MessageBox(NULL, L"Failed to open file.", L"Error", MB_OK | MB_ICONEXCLAMATION);
@@ -740,12 +728,99 @@ void Save() {
     if(GetSaveFileName(&ofn)) {
         wcscat(ofn.lpstrFile, L".scn");
 
-        if(scene_.Save(ofn.lpstrFile) == false) {
+        if(scene_.Save(ofn.lpstrFile, saveFrames_ != 0) == false) {
             MessageBox(NULL, L"Failed to save file.", L"Error", MB_OK | MB_ICONEXCLAMATION);
         }
     }
 }
 
+void ExportStl() {
+    if(selectedAction_ != NULL) {
+        UpdateAction(selectedAction_);
+    }
+
+    OPENFILENAME ofn;
+    wchar_t szFile[MAX_PATH + 1];
+
+    // Initialize the save file dialog.
+    ZeroMemory(&ofn, sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = NULL;
+    ofn.lpstrFile = szFile;
+    ofn.lpstrFile[0] = L'\0';
+    ofn.nMaxFile = sizeof(szFile);
+    ofn.lpstrFilter = L"STL\0*.STL\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrFileTitle = NULL;
+    ofn.nMaxFileTitle = 0;
+    ofn.lpstrInitialDir = NULL;
+    ofn.Flags = OFN_PATHMUSTEXIST;
+
+    if(GetSaveFileName(&ofn)) {
+        wcscat(ofn.lpstrFile, L".stl");
+
+        // The frames are generated while writing the file.
+        StlExporter exporter;
+
+        if(exporter.Save(scene_.Storyboard(), ofn.lpstrFile) == false) {
+            MessageBox(NULL, L"Failed to export file.", L"Error", MB_OK | MB_ICONEXCLAMATION);
+        }
+    }
+}
+
+// Exports the whole surface as an OBJ or PLY file (shared vertices).
+void ExportMesh(bool ply) {
+    if(selectedAction_ != NULL) {
+        UpdateAction(selectedAction_);
+    }
+
+    OPENFILENAME ofn;
+    wchar_t szFile[MAX_PATH + 1];
+
+    // Initialize the save file dialog.
+    ZeroMemory(&ofn, sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = NULL;
+    ofn.lpstrFile = szFile;
+    ofn.lpstrFile[0] = L'\0';
+    ofn.nMaxFile = sizeof(szFile);
+    ofn.lpstrFilter = ply ? L"PLY\0*.PLY\0" : L"OBJ\0*.OBJ\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrFileTitle = NULL;
+    ofn.nMaxFileTitle = 0;
+    ofn.lpstrInitialDir = NULL;
+    ofn.Flags = OFN_PATHMUSTEXIST;
+
+    if(GetSaveFileName(&ofn)) {
+        wcscat(ofn.lpstrFile, ply ? L".ply" : L".obj");
+
+        // Build the mesh of all frames, without changing the ones being played.
+        MeshBuilder builder;
+        List<Point> points;
+        int frameCount = scene_.Storyboard().FrameCount();
+
+        for(int i = 0; i < frameCount; i++) {
+            scene_.Storyboard().EvaluateAt(i, points);
+            builder.AddFrame(Frame(points));
+        }
+
+        bool saved;
+
+        if(ply) {
+            PlyExporter exporter;
+            saved = exporter.Save(builder.MeshObject(), ofn.lpstrFile);
+        }
+        else {
+            ObjExporter exporter;
+            saved = exporter.Save(builder.MeshObject(), ofn.lpstrFile);
+        }
+
+        if(saved == false) {
+            MessageBox(NULL, L"Failed to export file.", L"Error", MB_OK | MB_ICONEXCLAMATION);
+        }
+    }
+}
+
 void MouseHandler(int button, int state, int x, int y) {
     // Compute the coordinates relative to the origin of the coordinate system.
     int tx, ty, tw, th;
@@ -873,6 +948,24 @@ void ControlHandler(int id) {
             Save();
             break;
         }
+        case EXPORT_STL_ID: {
+            ExportStl();
+            break;
+        }
+        case EXPORT_OBJ_ID: {
+            ExportMesh(false);
+            break;
+        }
+        case EXPORT_PLY_ID: {
+            ExportMesh(true);
+            break;
+        }
+        case TOLERANCE_ID: {
+            // The frames are generated again with the new points.
+            ResetScene();
+            scene_.SetTolerance(tolerance_);
+            break;
+        }
         case ROTATE_Y: {
             rotationY_ += 5;
         }
@@ -907,6 +1000,10 @@ int main(int argc, char* argv[]) {
     panel->set_alignment(GLUI_ALIGN_LEFT);
     g->add_button_to_panel(panel,"Open", OPEN_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
     g->add_button_to_panel(panel,"Save", SAVE_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
+    g->add_checkbox_to_panel(panel, "Save Frames", &saveFrames_);
+    g->add_button_to_panel(panel,"Export STL", EXPORT_STL_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
+    g->add_button_to_panel(panel,"Export OBJ", EXPORT_OBJ_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
+    g->add_button_to_panel(panel,"Export PLY", EXPORT_PLY_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
     
     g->add_separator_to_panel(panel);
 
@@ -932,6 +1029,10 @@ int main(int argc, char* argv[]) {
     g->add_spinner_to_panel(loadPanel, "Size", 2, &shapeSize_)->set_alignment(GLUI_ALIGN_LEFT);
     g->add_spinner_to_panel(loadPanel, "Points", 2, &shapePoints_)->set_alignment(GLUI_ALIGN_LEFT);
     g->add_checkbox_to_panel(loadPanel, "On Z axis", &onZ);
+    toleranceSpinner_ = g->add_spinner_to_panel(loadPanel, "Bezier Tolerance", GLUI_SPINNER_FLOAT, 
+                                                &tolerance_, TOLERANCE_ID, ControlHandler);
+    toleranceSpinner_->set_float_limits(0, 10);
+    toleranceSpinner_->set_alignment(GLUI_ALIGN_LEFT);
     g->add_button_to_panel(loadPanel,"Create Shape", LOAD_SHAPE_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
     g->add_button_to_panel(loadPanel,"Reset Shape", RESET_SHAPE_ID, ControlHandler)->set_alignment(GLUI_ALIGN_LEFT);
 
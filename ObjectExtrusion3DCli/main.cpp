@@ -0,0 +1,288 @@
+// Copyright (c) 2010 Gratian Lup. All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following
+// disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// * The name "ObjectExtrusion3D" must not be used to endorse or promote
+// products derived from this software without prior written permission.
+//
+// * Products derived from this software may not be called "ObjectExtrusion3D" nor
+// may "ObjectExtrusion3D" appear in their names without prior written
+// permission of the author.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Command line version of ObjectExtrusion3D, which doesn't need OpenGL or
+// a window. It loads a scene, plays its storyboard and writes the mesh.
+//
+// Usage: ObjectExtrusion3DCli [-threads count] [-float] [-tolerance value] 
+//                             scene.scn output.(stl|obj|ply)
+//        ObjectExtrusion3DCli [-threads count] [-float] [-tolerance value] 
+//                             -batch (directory|manifest) -out directory [-format stl|obj|ply]
+//
+// On Linux it can be built with:
+//     g++ -std=c++11 -O2 -I../ObjectExtrusion3D main.cpp -o extrude -pthread
+
+#include "Scene.hpp"
+#include "Storyboard.hpp"
+#include "ThreadPool.hpp"
+#include "MeshBuilder.hpp"
+#include "StlExporter.hpp"
+#include "MeshExporter.hpp"
+#include "BatchProcessor.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <chrono>
+
+void PrintUsage() {
+    fprintf(stderr, "Usage: ObjectExtrusion3DCli [-threads count] [-float] [-tolerance value]\n"
+                    "                            scene.scn output.(stl|obj|ply)\n"
+                    "       ObjectExtrusion3DCli [-threads count] [-float] [-tolerance value]\n"
+                    "                            -batch (directory|manifest) -out directory\n"
+                    "                            [-format stl|obj|ply]\n"
+                    "  -threads count  Worker threads (0 = one per hardware thread, the default).\n"
+                    "  -float          Compute the frames and the mesh in float32 instead of double.\n"
+                    "  -tolerance value  Tessellate Bezier shapes so the curves are at most 'value'\n"
+                    "                  away from the lines (0 = fixed number of points).\n"
+                    "                  By default the tolerance saved with the scene is used.\n"
+                    "  -batch path     A directory with .scn files, or a text file\n"
+                    "                  with the path of a scene on each line.\n"
+                    "  -out directory  Where the meshes of a batch are written.\n"
+                    "  -format name    The format of the meshes of a batch (default ply).\n");
+}
+
+// Streams use wide paths; the arguments are converted using the current locale.
+bool WidePath(const char *path, wchar_t *widePath, size_t size) {
+    size_t length = mbstowcs(widePath, path, size);
+    return (length != (size_t)-1) && (length < size);
+}
+
+double ElapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count();
+}
+
+// Writes the mesh in the OBJ or PLY format and reports its size.
+template <class P>
+bool SaveMesh(BasicMesh<P> &mesh, MeshFormat format, wchar_t *output) {
+    bool saved;
+
+    if(format == FORMAT_OBJ) {
+        ObjExporter exporter;
+        saved = exporter.Save(mesh, output);
+        printf("%u vertices, %u normals, %u triangles\n", 
+               (unsigned)exporter.VertexCount(), (unsigned)exporter.NormalCount(),
+               (unsigned)mesh.TriangleCount());
+    }
+    else {
+        PlyExporter exporter;
+        saved = exporter.Save(mesh, output);
+        printf("%u vertices, %u triangles\n", 
+               (unsigned)exporter.VertexCount(), (unsigned)mesh.TriangleCount());
+    }
+
+    return saved;
+}
+
+// Extrudes all scenes of a batch in parallel and reports each of them.
+int RunBatch(const char *scenes, const char *outputDirectory, 
+             MeshFormat format, bool useFloat, double tolerance, size_t threadCount) {
+    BatchProcessor batch(format, useFloat);
+
+    if(tolerance >= 0) {
+        batch.SetTolerance(tolerance);
+    }
+
+    if(!batch.AddScenes(scenes, outputDirectory)) {
+        fprintf(stderr, "Failed to read batch: %s\n", scenes);
+        return 2;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = 
+        std::chrono::high_resolution_clock::now();
+    ThreadPool pool(threadCount);
+    batch.Run(&pool);
+    double totalTime = ElapsedMs(start);
+
+    for(size_t i = 0; i < batch.Count(); i++) {
+        const BatchResult &result = batch.Result(i);
+
+        if(result.Error != NULL) {
+            printf("FAILED %s: %s\n", result.Input.c_str(), result.Error);
+        }
+        else {
+            printf("ok     %s: %u frames, %u triangles; "
+                   "load %.1f ms, extrude %.1f ms, write %.1f ms\n",
+                   result.Input.c_str(), (unsigned)result.Frames, (unsigned)result.Triangles,
+                   result.LoadTime, result.ExtrudeTime, result.WriteTime);
+        }
+    }
+
+    printf("%u scenes, %u failed, %.1f ms on %u threads\n", 
+           (unsigned)batch.Count(), (unsigned)batch.FailedCount(), 
+           totalTime, (unsigned)pool.ThreadCount());
+    return batch.FailedCount() == 0 ? 0 : 3;
+}
+
+int main(int argc, char **argv) {
+    size_t threadCount = 0;
+    const char *inputPath = NULL;
+    const char *outputPath = NULL;
+    const char *batchPath = NULL;
+    const char *outputDirectory = NULL;
+    MeshFormat batchFormat = FORMAT_PLY;
+    bool useFloat = false;
+    double tolerance = -1; // The one saved with the scene.
+
+    for(int i = 1; i < argc; i++) {
+        if((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+            threadCount = (size_t)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-float") == 0) {
+            useFloat = true;
+        }
+        else if((strcmp(argv[i], "-tolerance") == 0) && (i + 1 < argc)) {
+            char *end;
+            tolerance = strtod(argv[++i], &end);
+
+            if((*end != '\0') || !(tolerance >= 0)) {
+                fprintf(stderr, "Invalid tolerance: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if((strcmp(argv[i], "-batch") == 0) && (i + 1 < argc)) {
+            batchPath = argv[++i];
+        }
+        else if((strcmp(argv[i], "-out") == 0) && (i + 1 < argc)) {
+            outputDirectory = argv[++i];
+        }
+        else if((strcmp(argv[i], "-format") == 0) && (i + 1 < argc)) {
+            std::string name = std::string(".") + argv[++i];
+            batchFormat = FormatFromPath(name.c_str());
+
+            if(batchFormat == FORMAT_UNKNOWN) {
+                fprintf(stderr, "Unknown format: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(inputPath == NULL) {
+            inputPath = argv[i];
+        }
+        else if(outputPath == NULL) {
+            outputPath = argv[i];
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if(batchPath != NULL) {
+        if((outputDirectory == NULL) || (inputPath != NULL)) {
+            PrintUsage();
+            return 1;
+        }
+
+        return RunBatch(batchPath, outputDirectory, batchFormat, useFloat, tolerance, threadCount);
+    }
+
+    if((inputPath == NULL) || (outputPath == NULL)) {
+        PrintUsage();
+        return 1;
+    }
+
+    MeshFormat format = FormatFromPath(outputPath);
+
+    if(format == FORMAT_UNKNOWN) {
+        fprintf(stderr, "Unknown output format: %s\n", outputPath);
+        return 1;
+    }
+
+    wchar_t input[4096];
+    wchar_t output[4096];
+
+    if(!WidePath(inputPath, input, 4096) || !WidePath(outputPath, output, 4096)) {
+        fprintf(stderr, "Invalid path.\n");
+        return 1;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = 
+        std::chrono::high_resolution_clock::now();
+    Scene scene;
+
+    if(!scene.Open(input) || (scene.ShapeObject() == NULL)) {
+        fprintf(stderr, "Failed to open scene: %s\n", inputPath);
+        return 2;
+    }
+
+    if(tolerance >= 0) {
+        scene.SetTolerance(tolerance);
+    }
+
+    double loadTime = ElapsedMs(start);
+    Storyboard &storyboard = scene.Storyboard();
+    start = std::chrono::high_resolution_clock::now();
+    bool saved;
+
+    if(format == FORMAT_STL) {
+        // The STL exporter evaluates the frames while writing them.
+        StlExporter exporter;
+        saved = exporter.Save(storyboard, output);
+        printf("%u triangles\n", (unsigned)exporter.TriangleCount());
+    }
+    else if(useFloat && !storyboard.IsGenerated()) {
+        FrameStoreF frames;
+        ThreadPool pool(threadCount);
+        storyboard.GenerateFrames(frames, &pool);
+
+        MeshBuilderF builder;
+        builder.Update(frames);
+        saved = SaveMesh(builder.MeshObject(), format, output);
+    }
+    else if(useFloat) {
+        // Scenes saved with their frames don't need to be evaluated.
+        MeshBuilderF builder;
+        builder.Update(storyboard.Frames());
+        saved = SaveMesh(builder.MeshObject(), format, output);
+    }
+    else {
+        if(!storyboard.IsGenerated()) {
+            ThreadPool pool(threadCount);
+            storyboard.GenerateFrames(&pool);
+        }
+
+        MeshBuilder builder;
+        builder.Update(storyboard.Frames());
+        saved = SaveMesh(builder.MeshObject(), format, output);
+    }
+
+    if(!saved) {
+        fprintf(stderr, "Failed to write mesh: %s\n", outputPath);
+        return 3;
+    }
+
+    printf("%d frames; load %.1f ms, extrude and write %.1f ms\n", 
+           storyboard.FrameCount(), loadTime, ElapsedMs(start));
+    return 0;
+}